@@ -0,0 +1,24 @@
+#!/bin/sh
+# build.sh
+# Builds chip8-emulator.exe with MinGW-w64 from a Git Bash or MSYS2 shell:
+#
+#     ./build.sh
+#
+# 1. Generates src/include/chip8/romdb_table.h (ROM database) with
+#    tools/romdb_gen.cpp from the chip-8-database. The database is cloned
+#    into external/chip-8-database on the first build; CHIP8_DATABASE
+#    points to another checkout.
+# 2. Compiles the emulator from src/cpp_files_list.txt (paths set as in
+#    the README).
+set -e
+cd "$(dirname "$0")"
+
+DATABASE="${CHIP8_DATABASE:-external/chip-8-database}"
+if [ ! -f "$DATABASE/database/programs.json" ]; then
+    git clone --depth 1 https://github.com/chip-8/chip-8-database.git "$DATABASE"
+fi
+
+g++ -std=c++17 -Isrc/include/chip8 src/tools/romdb_gen.cpp -o romdb_gen
+./romdb_gen "$DATABASE/database" src/include/chip8/romdb_table.h
+
+g++ -g -std=c++17 -Isrc/include/SDL2 -Isrc/include/imgui -Isrc/include/chip8 -Lsrc/lib @src/cpp_files_list.txt src/main.cpp -lmingw32 -lSDL2main -lSDL2 -lws2_32 -o chip8-emulator.exe
@@ -0,0 +1,185 @@
+#include <audio.h>
+#include <string.h>
+#include <math.h>
+
+
+//Default pattern: 8 bits high, 8 bits low (250 Hz square wave at pitch 64)
+static const unsigned char defaultPattern[16] = {
+    0xFF, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0xFF, 0x00,
+    0xFF, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0xFF, 0x00
+};
+
+static const Sint16 AMPLITUDE = 3000;
+
+
+Audio::Audio() : head(0), tail(0), emuClock(0) {
+    samplesPerFrame = SAMPLE_RATE / 60;
+    memcpy(state.pattern, defaultPattern, 16);
+    state.pitch = DEFAULT_PITCH;
+    state.playing = false;
+    pending = false;
+    pendingTime = 0;
+    historyCount = 0;
+    playState = state;
+    phase = 0;
+    playClock = 0;
+    synced = false;
+    device = 0;
+    memset(phaseStep, 0, sizeof(phaseStep));
+}
+
+void Audio::init() {
+
+    SDL_AudioSpec want;
+    SDL_AudioSpec have;
+    SDL_zero(want);
+    want.freq = SAMPLE_RATE;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = 512;
+    want.callback = Audio::callback;
+    want.userdata = this;
+
+    device = SDL_OpenAudioDevice(NULL, 0, &want, &have, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    if (device == 0) {
+        return;
+    }
+
+    samplesPerFrame = have.freq / 60;
+
+    //Precompute the phase increment for every pitch value
+    //The 32-bit phase covers the 128 bit pattern, so one bit is 2^25
+    for (int p = 0; p < 256; p++)
+    {
+        double bitsPerSecond = 4000.0 * pow(2.0, (p - 64) / 48.0);
+        phaseStep[p] = (unsigned int)(bitsPerSecond / have.freq * 33554432.0);
+    }
+
+    SDL_PauseAudioDevice(device, 0);
+}
+
+void Audio::close() {
+    if (device != 0) {
+        SDL_CloseAudioDevice(device);
+        device = 0;
+    }
+}
+
+void Audio::reset(unsigned long long time) {
+    memcpy(state.pattern, defaultPattern, 16);
+    state.pitch = DEFAULT_PITCH;
+    state.playing = false;
+    send(time);
+}
+
+void Audio::setPlaying(bool playing, unsigned long long time) {
+    if (state.playing == playing) {
+        return;
+    }
+    state.playing = playing;
+    send(time);
+}
+
+void Audio::setPattern(const unsigned char* pattern, unsigned long long time) {
+    memcpy(state.pattern, pattern, 16);
+    send(time);
+}
+
+void Audio::setPitch(unsigned char pitch, unsigned long long time) {
+    state.pitch = pitch;
+    send(time);
+}
+
+//Called once per emulated frame with the current emulated time
+void Audio::flush(unsigned long long now) {
+    if (pending && push(pendingTime)) {
+        pending = false;
+    }
+    emuClock.store(now, std::memory_order_release);
+}
+
+//State the emulation last set
+Audio::State Audio::current() {
+    return state;
+}
+
+void Audio::send(unsigned long long time) {
+    history[historyCount & (HISTORY_SIZE - 1)].time = time;
+    history[historyCount & (HISTORY_SIZE - 1)].state = state;
+    historyCount++;
+
+    //Queue full: keep the newest state and retry on the next flush
+    if (push(time)) {
+        pending = false;
+    } else {
+        pending = true;
+        pendingTime = time;
+    }
+}
+
+bool Audio::push(unsigned long long time) {
+    unsigned int h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == QUEUE_SIZE) {
+        return false;
+    }
+    queue[h & (QUEUE_SIZE - 1)].time = time;
+    queue[h & (QUEUE_SIZE - 1)].state = state;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+void Audio::callback(void* userdata, Uint8* stream, int len) {
+    ((Audio*)userdata)->mix((Sint16*)stream, len / (int)sizeof(Sint16));
+}
+
+void Audio::mix(Sint16* out, int samples) {
+
+    //Keep playback a couple of frames behind the emulator. When the emulator
+    //runs ahead (fast-forward) jump forward instead of letting latency grow.
+    unsigned long long now = emuClock.load(std::memory_order_acquire);
+    unsigned long long latency = samplesPerFrame * 2;
+    if (!synced || now > playClock + latency * 2) {
+        playClock = now > latency ? now - latency : 0;
+        synced = true;
+    }
+
+    unsigned int t = tail.load(std::memory_order_relaxed);
+    unsigned int h = head.load(std::memory_order_acquire);
+    int n = 0;
+
+    while (n < samples)
+    {
+        //Apply every snapshot that is due
+        while (t != h && queue[t & (QUEUE_SIZE - 1)].time <= playClock)
+        {
+            playState = queue[t & (QUEUE_SIZE - 1)].state;
+            t++;
+        }
+
+        //Render up to the next snapshot (sample accurate)
+        int run = samples - n;
+        if (t != h) {
+            unsigned long long next = queue[t & (QUEUE_SIZE - 1)].time - playClock;
+            if (next < (unsigned long long)run) {
+                run = (int)next;
+            }
+        }
+
+        if (playState.playing) {
+            unsigned int step = phaseStep[playState.pitch];
+            for (int i = 0; i < run; i++)
+            {
+                unsigned int bit = phase >> 25;
+                out[n + i] = (playState.pattern[bit >> 3] >> (7 - (bit & 7))) & 1 ? AMPLITUDE : -AMPLITUDE;
+                phase += step;
+            }
+        } else {
+            memset(out + n, 0, run * sizeof(Sint16));
+        }
+
+        n += run;
+        playClock += run;
+    }
+
+    tail.store(t, std::memory_order_release);
+}
@@ -0,0 +1,203 @@
+#include <callgraph.h>
+#include <stdio.h>
+#include <fstream>
+#include <map>
+
+
+CallGraph::CallGraph() {
+    enabled = false;
+    interval = 1;
+    reset(0x200);
+}
+
+//Start a new tree (new ROM, or the counts were cleared)
+void CallGraph::reset(unsigned short entry) {
+    Node root;
+    root.address = entry;
+    root.parent = -1;
+    root.firstChild = -1;
+    root.nextSibling = -1;
+    root.self = 0;
+    root.calls = 1;
+
+    nodes.clear();
+    nodes.push_back(root);
+    current = 0;
+    overflow = 0;
+    untilSample = interval > 0 ? interval : 1;
+}
+
+//Called once per instruction
+void CallGraph::sample() {
+    if (--untilSample == 0) {
+        untilSample = interval > 0 ? interval : 1;
+        nodes[current].self += untilSample;
+    }
+}
+
+//2NNN
+void CallGraph::enter(unsigned short address) {
+
+    //Out of nodes: keep counting in the caller until it returns
+    if (overflow > 0 || nodes.size() >= MAX_NODES) {
+        int existing = overflow == 0 ? child(current, address) : -1;
+        if (existing < 0) {
+            overflow++;
+            return;
+        }
+        current = existing;
+        nodes[current].calls++;
+        return;
+    }
+
+    int node = child(current, address);
+    if (node < 0) {
+        Node callee;
+        callee.address = address;
+        callee.parent = current;
+        callee.firstChild = -1;
+        callee.nextSibling = nodes[current].firstChild;
+        callee.self = 0;
+        callee.calls = 0;
+        node = (int)nodes.size();
+        nodes.push_back(callee);
+        nodes[current].firstChild = node;
+    }
+    current = node;
+    nodes[current].calls++;
+}
+
+//00EE
+void CallGraph::leave() {
+    if (overflow > 0) {
+        overflow--;
+        return;
+    }
+    //A RET without a matching CALL (stack tricks) stays at the root
+    if (nodes[current].parent >= 0) {
+        current = nodes[current].parent;
+    }
+}
+
+int CallGraph::child(int parent, unsigned short address) {
+    for (int node = nodes[parent].firstChild; node >= 0; node = nodes[node].nextSibling)
+    {
+        if (nodes[node].address == address) {
+            return node;
+        }
+    }
+    return -1;
+}
+
+//Self + everything called from the node
+unsigned long long CallGraph::total(int node) {
+    unsigned long long sum = nodes[node].self;
+    for (int c = nodes[node].firstChild; c >= 0; c = nodes[c].nextSibling)
+    {
+        sum += total(c);
+    }
+    return sum;
+}
+
+std::string CallGraph::name(int node) {
+    char text[16];
+    if (node == 0) {
+        snprintf(text, sizeof(text), "main_%03X", nodes[node].address);
+    } else {
+        snprintf(text, sizeof(text), "sub_%03X", nodes[node].address);
+    }
+    return text;
+}
+
+//Brendan Gregg's folded stacks: "main_200;sub_2A0;sub_300 1234"
+bool CallGraph::saveFolded(const std::string& path) {
+
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+
+    for (size_t node = 0; node < nodes.size(); node++)
+    {
+        if (nodes[node].self == 0) {
+            continue;
+        }
+        std::string stack = name((int)node);
+        for (int parent = nodes[node].parent; parent >= 0; parent = nodes[parent].parent)
+        {
+            stack = name(parent) + ";" + stack;
+        }
+        file << stack << " " << nodes[node].self << "\n";
+    }
+    return file.good();
+}
+
+//speedscope file format, one weighted sample per node with self time
+bool CallGraph::saveSpeedscope(const std::string& path, const std::string& title) {
+
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+
+    //Frames are shared between nodes of the same subroutine
+    std::map<std::string, int> frameIndex;
+    std::vector<std::string> frames;
+    std::vector<int> nodeFrame(nodes.size());
+    for (size_t node = 0; node < nodes.size(); node++)
+    {
+        std::string frame = name((int)node);
+        auto found = frameIndex.find(frame);
+        if (found == frameIndex.end()) {
+            found = frameIndex.emplace(frame, (int)frames.size()).first;
+            frames.push_back(frame);
+        }
+        nodeFrame[node] = found->second;
+    }
+
+    std::string escaped;
+    for (char c : title)
+    {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += (unsigned char)c < 0x20 ? ' ' : c;
+    }
+
+    file << "{\"$schema\":\"https://www.speedscope.app/file-format-schema.json\",";
+    file << "\"exporter\":\"chip8-emulator\",\"name\":\"" << escaped << "\",";
+    file << "\"shared\":{\"frames\":[";
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        file << (i ? "," : "") << "{\"name\":\"" << frames[i] << "\"}";
+    }
+    file << "]},\"profiles\":[{\"type\":\"sampled\",\"name\":\"" << escaped << "\",\"unit\":\"none\",";
+
+    std::string samples;
+    std::string weights;
+    unsigned long long sum = 0;
+    for (size_t node = 0; node < nodes.size(); node++)
+    {
+        if (nodes[node].self == 0) {
+            continue;
+        }
+        //Root first
+        std::vector<int> stack;
+        for (int n = (int)node; n >= 0; n = nodes[n].parent)
+        {
+            stack.insert(stack.begin(), nodeFrame[n]);
+        }
+        samples += samples.empty() ? "[" : ",[";
+        for (size_t i = 0; i < stack.size(); i++)
+        {
+            samples += (i ? "," : "") + std::to_string(stack[i]);
+        }
+        samples += "]";
+        weights += (weights.empty() ? "" : ",") + std::to_string(nodes[node].self);
+        sum += nodes[node].self;
+    }
+
+    file << "\"startValue\":0,\"endValue\":" << sum << ",";
+    file << "\"samples\":[" << samples << "],\"weights\":[" << weights << "]}]}\n";
+    return file.good();
+}
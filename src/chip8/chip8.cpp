@@ -1,21 +1,68 @@
 #include <chip8.h>
 #include <graphics.h>
+#include <romdb.h>
+#include <sha1.h>
 #include <string.h>
 #include <iostream>
 #include <fstream>
 #include <stack>
+#include <array>
+#include <utility>
 
 using namespace std; 
 
+//Opcode as 4 hex digits (log lines)
+static string opcodeText(unsigned short opcode) {
+    char text[5];
+    snprintf(text, sizeof(text), "%04X", opcode);
+    return text;
+}
+
+static_assert(Recorder::PLANES == DISPLAY_PLANES && Recorder::ROWS == DISPLAY_ROWS && Recorder::WORDS == DISPLAY_WORDS, "recorder display layout");
+
+
+//Quirks as seen by an interpreter compiled for QuirkBits: constants, or the
+//run time Quirks for QUIRKS_DYNAMIC. The constant ones fold away, so each
+//profile gets an interpreter without quirk branches.
+template <unsigned int QuirkBits>
+struct QuirkPolicy {
+    static const bool dynamic = (QuirkBits & QUIRKS_DYNAMIC) != 0;
 
-Chip8::Chip8() : graphics() {
+    static bool shift(const Quirks& q)          { return dynamic ? q.shift : (QuirkBits & QUIRK_SHIFT) != 0; }
+    static bool memoryIncrementByX(const Quirks& q) { return dynamic ? q.memoryIncrementByX : (QuirkBits & QUIRK_MEMORY_INCREMENT) != 0; }
+    static bool memoryLeaveIUnchanged(const Quirks& q) { return dynamic ? q.memoryLeaveIUnchanged : (QuirkBits & QUIRK_MEMORY_LEAVE_I) != 0; }
+    static bool wrap(const Quirks& q)           { return dynamic ? q.wrap : (QuirkBits & QUIRK_WRAP) != 0; }
+    static bool jump(const Quirks& q)           { return dynamic ? q.jump : (QuirkBits & QUIRK_JUMP) != 0; }
+    static bool vblank(const Quirks& q)         { return dynamic ? q.vblank : (QuirkBits & QUIRK_VBLANK) != 0; }
+    static bool logic(const Quirks& q)          { return dynamic ? q.logic : (QuirkBits & QUIRK_LOGIC) != 0; }
+};
+
+//Quirk sets compiled into their own interpreter
+static constexpr unsigned int quirkProfiles[] = { QUIRKS_CHIP8, QUIRKS_SCHIP, QUIRKS_XOCHIP, QUIRKS_VIP };
+static const int QUIRK_PROFILE_COUNT = sizeof(quirkProfiles) / sizeof(quirkProfiles[0]);
+
+
+Chip8::Chip8(bool headless) : graphics() {
     pc = 0x200;
     index = 0x0000;
     delay_timer = 0x000;
     sp = 0;
     sound_timer = 0x000;
     drawFlag = false;
+    hires = false;
+    planes = 1;
     pressedKey = -1;
+    platform = Platform::CHIP8;
+    setQuirks(platformQuirks(platform));
+    ipf = platformSpeed(platform);
+    frameCount = 0;
+    frameStep = 0;
+    waitSkipped = 0;
+    lastWaitSkipped = 0;
+    idleSkip = true;
+    idleSkipped = 0;
+    lastIdleSkipped = 0;
+    randomState = (unsigned int)rand() | 1;
     keymap[SDL_SCANCODE_1] = 0x1;
     keymap[SDL_SCANCODE_2] = 0x2;
     keymap[SDL_SCANCODE_3] = 0x3;
@@ -39,11 +86,17 @@ Chip8::Chip8() : graphics() {
     {
         memory[i] = font[i];
     }
+    memcpy(&memory[BIG_FONT], bigFont, sizeof(bigFont));
 
-    debugMode = true;
+    debugMode = !headless;
 
-    initGraphics();
+    //Headless: no window and no audio device (tools, tests)
+    if (!headless) {
+        initGraphics();
+        audio.init();
+    }
 
+    logCount = 0;
     pushLog("Chip8 Initialized");
 
 }
@@ -75,12 +128,101 @@ void Chip8::pushLog(string log) {
         console[i] = console[i - 1];
     }
     console[0] = log;
+    logCount++;
 }
 
 void Chip8::initGraphics() {
     graphics.init();
 }
 
+//Per instance generator (xorshift32), so runs can be reproduced from a seed
+unsigned char Chip8::nextRandom() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return (unsigned char)(randomState >> 24);
+}
+
+void Chip8::seedRandom(unsigned int seed) {
+    randomState = seed != 0 ? seed : 1;
+}
+
+//SHA-1 of the display at the current resolution, packed 8 pixels per byte,
+//row by row (golden screenshots). The second plane is only hashed when
+//something was drawn on it, so monochrome screens hash the same as before.
+std::string Chip8::displayHash() {
+    unsigned char packed[DISPLAY_PLANES * DISPLAY_ROWS * DISPLAY_WORDS * 8];
+    size_t length = 0;
+    for (int plane = 0; plane < DISPLAY_PLANES; plane++)
+    {
+        size_t start = length;
+        bool used = false;
+        for (int y = 0; y < displayHeight(); y++)
+        {
+            for (int w = 0; w < displayWidth() / 64; w++)
+            {
+                used |= display[plane][y][w] != 0;
+                for (int b = 7; b >= 0; b--)
+                {
+                    packed[length++] = (unsigned char)(display[plane][y][w] >> (b * 8));
+                }
+            }
+        }
+        if (plane > 0 && !used) {
+            length = start;
+        }
+    }
+    unsigned char digest[20];
+    SHA1 sha;
+    sha.update(packed, length);
+    sha.final(digest);
+    return SHA1::toHex(digest);
+}
+
+int Chip8::displayWidth() {
+    return hires ? 128 : 64;
+}
+
+int Chip8::displayHeight() {
+    return hires ? 64 : 32;
+}
+
+//Palette index of a pixel (one bit per plane)
+unsigned char Chip8::pixel(int x, int y) {
+    unsigned char colour = 0;
+    for (int plane = 0; plane < DISPLAY_PLANES; plane++)
+    {
+        colour |= ((display[plane][y][x >> 6] >> (63 - (x & 63))) & 1) << plane;
+    }
+    return colour;
+}
+
+//Clear the planes in mask (CLS only clears the selected planes)
+void Chip8::clearDisplay(unsigned char mask) {
+    for (int plane = 0; plane < DISPLAY_PLANES; plane++)
+    {
+        if (mask & (1 << plane)) {
+            memset(display[plane], 0, sizeof(display[plane]));
+        }
+    }
+    drawFlag = true;
+}
+
+//00FE/00FF: switching resolution clears every plane
+void Chip8::setResolution(bool high) {
+    hires = high;
+    clearDisplay();
+}
+
+//Skip the next instruction (F000 NNNN is 4 bytes long on XO-CHIP)
+inline void Chip8::skip() {
+    if (platform == Platform::XOCHIP && memory[pc] == 0xF0 && memory[(pc + 1) & 0xFFFF] == 0x00) {
+        pc = pc + 4;
+    } else {
+        pc = pc + 2;
+    }
+}
+
 void Chip8::pressKey(SDL_Keycode key) {
     if(key == -1) {
         pressedKey = -1;
@@ -89,54 +231,212 @@ void Chip8::pressKey(SDL_Keycode key) {
     pressedKey = keymap[key];
 }
 
-void Chip8::loadROM(string fileName) {
-
-    //Open File
-    std::ifstream infile(fileName, std::ios::in | std::ios::binary);
+//Read and check a ROM file without touching the machine. profile gets the
+//platform, quirks and speed it runs with (ROM database, else the current platform).
+ROMResult Chip8::readROM(const string& fileName, std::vector<unsigned char>& data, RomProfile& profile) {
+
+    ROMResult result;
+    result.status = ROMStatus::OK;
+    result.size = 0;
+    result.identified = false;
+
+    //Open File (positioned at the end to get its length)
+    std::ifstream infile(fileName, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!infile.is_open()) {
+        result.status = ROMStatus::NotFound;
+        result.message = "Could not open " + fileName;
+        return result;
+    }
 
     // Get length of file
-    infile.seekg(0, std::ios::end);
-    size_t length = infile.tellg();
+    std::streamoff length = infile.tellg();
+    if (length <= 0) {
+        result.status = ROMStatus::Empty;
+        result.message = fileName + " is empty";
+        return result;
+    }
+
+    //Nothing can be larger than the biggest program space (XO-CHIP)
+    if ((size_t)length > sizeof(memory) - 0x200) {
+        result.status = ROMStatus::TooLarge;
+        result.size = (size_t)length;
+        result.message = fileName + " is " + to_string(length) + " bytes (max " + to_string(sizeof(memory) - 0x200) + ")";
+        return result;
+    }
+
+    data.resize((size_t)length);
     infile.seekg(0, std::ios::beg);
+    infile.read((char*)data.data(), length);
+    if (infile.gcount() != length) {
+        result.status = ROMStatus::ReadError;
+        result.message = "Failed to read " + fileName;
+        return result;
+    }
+
+    //Known ROM: platform, quirks and speed come from the ROM database
+    unsigned char digest[20];
+    SHA1 sha;
+    sha.update(data.data(), data.size());
+    sha.final(digest);
+
+    if (romdbLookup(digest, profile)) {
+        if (profile.ipf == 0) {
+            profile.ipf = platformSpeed(profile.platform);
+        }
+        result.identified = true;
+        result.title = profile.title;
+    } else {
+        profile.platform = platform;
+        profile.quirks = platformQuirks(platform);
+        profile.ipf = platformSpeed(platform);
+    }
 
-    char buffer[length];
+    //Validate against the program space of the selected variant
+    size_t maxSize = (profile.platform == Platform::XOCHIP ? 0x10000 : 0x1000) - 0x200;
+    result.size = (size_t)length;
+    if ((size_t)length > maxSize) {
+        result.status = ROMStatus::TooLarge;
+        result.message = fileName + " is " + to_string(length) + " bytes (max " + to_string(maxSize) + ")";
+    }
+    return result;
+}
 
-    // Read file
-    infile.read(buffer, length);
+//Load a ROM in place of the current one. The machine is only reset once the
+//file is read and checked, so a rejected ROM leaves the running program alone.
+ROMResult Chip8::loadROM(string fileName) {
 
-    //Load file to Memory [Program Data]
-    for (int i = 0; i < length; i++)
-    {
-        memory[i + 512] = buffer[i];
+    std::vector<unsigned char> data;
+    RomProfile profile;
+    ROMResult result = readROM(fileName, data, profile);
+    if (result.status != ROMStatus::OK) {
+        return result;
     }
 
-    //Dump Memory
-    //cout << "Dump Memory: " << endl;
-    //for (int i = 0; i < length; i++)
-    //{
-    //    cout << (i + pc) << " - " << hex << (int)memory[i + pc] << endl;
-    //}
-    //cout << "------------------" << endl;
-    //Close File
-    infile.close();
+    // Copy into Memory [Program Data]
+    unLoadROM();
+    memcpy(&memory[0x200], data.data(), data.size());
+    touchMemory(0x200, (unsigned int)data.size());
+    platform = profile.platform;
+    setQuirks(profile.quirks);
+    ipf = profile.ipf;
+    romPath = fileName;
+    return result;
 }
 
-void Chip8::unLoadROM() {
+//Load the current ROM file again (Hot Reload). A file that can't be loaded
+//(caught half written by the editor) leaves the running program alone.
+ROMResult Chip8::reloadROM(bool keepRegisters) {
 
-    //Reset Memory (ROM)
-    for (int i = 0; i < 4096; i++)
+    std::string fileName = romPath;
+    std::vector<unsigned char> data;
+    RomProfile profile;
+    ROMResult result = readROM(fileName, data, profile);
+    if (result.status != ROMStatus::OK) {
+        return result;
+    }
+
+    //Save CPU State
+    unsigned char savedV[16];
+    unsigned short savedStack[16];
+    memcpy(savedV, v, sizeof(v));
+    memcpy(savedStack, stack, sizeof(stack));
+    unsigned short savedPC = pc;
+    unsigned short savedIndex = index;
+    unsigned char savedSP = sp;
+    unsigned char savedDelay = delay_timer;
+
+    unLoadROM();
+    memcpy(&memory[0x200], data.data(), data.size());
+    touchMemory(0x200, (unsigned int)data.size());
+    platform = profile.platform;
+    setQuirks(profile.quirks);
+    ipf = profile.ipf;
+
+    //Restore CPU State (quick iteration on the same program)
+    if (keepRegisters) {
+        memcpy(v, savedV, sizeof(v));
+        memcpy(stack, savedStack, sizeof(stack));
+        pc = savedPC;
+        index = savedIndex;
+        sp = savedSP;
+        delay_timer = savedDelay;
+    }
+    return result;
+}
+
+//Size of the addressable memory for the current variant
+unsigned int Chip8::addressSpace() {
+    return platform == Platform::XOCHIP ? 0x10000 : 0x1000;
+}
+
+//Quirks used when a ROM is not in the database
+Quirks Chip8::platformQuirks(Platform platform) {
+    switch (platform)
     {
-        memory[i + 512] = 0;
+        case Platform::SCHIP:
+            return quirksFromBits(QUIRKS_SCHIP);
+        case Platform::XOCHIP:
+            return quirksFromBits(QUIRKS_XOCHIP);
+        default:
+            //Unknown CHIP-8 ROMs keep the behaviour this emulator always had
+            return quirksFromBits(QUIRKS_CHIP8);
     }
+}
+
+Quirks Chip8::quirksFromBits(unsigned int bits) {
+    Quirks q;
+    q.shift = (bits & QUIRK_SHIFT) != 0;
+    q.memoryIncrementByX = (bits & QUIRK_MEMORY_INCREMENT) != 0;
+    q.memoryLeaveIUnchanged = (bits & QUIRK_MEMORY_LEAVE_I) != 0;
+    q.wrap = (bits & QUIRK_WRAP) != 0;
+    q.jump = (bits & QUIRK_JUMP) != 0;
+    q.vblank = (bits & QUIRK_VBLANK) != 0;
+    q.logic = (bits & QUIRK_LOGIC) != 0;
+    return q;
+}
 
-    //Reset Display
-    for (int i = 0; i < 64; i++)
+unsigned int Chip8::quirkBits(const Quirks& q) {
+    return (q.shift ? QUIRK_SHIFT : 0) | (q.memoryIncrementByX ? QUIRK_MEMORY_INCREMENT : 0) |
+           (q.memoryLeaveIUnchanged ? QUIRK_MEMORY_LEAVE_I : 0) | (q.wrap ? QUIRK_WRAP : 0) |
+           (q.jump ? QUIRK_JUMP : 0) | (q.vblank ? QUIRK_VBLANK : 0) | (q.logic ? QUIRK_LOGIC : 0);
+}
+
+//Pick the compiled interpreter for these quirks (QUIRKS_DYNAMIC when none matches)
+void Chip8::setQuirks(const Quirks& q) {
+    quirks = q;
+    quirkProfile = -1;
+    for (int i = 0; i < QUIRK_PROFILE_COUNT; i++)
     {
-        for (int j = 0; j < 32; j++)
-        {
-            display[i][j] = 0;
+        if (quirkBits(q) == quirkProfiles[i]) {
+            quirkProfile = i;
         }
     }
+}
+
+//Instructions per Frame used when a ROM is not in the database
+unsigned short Chip8::platformSpeed(Platform platform) {
+    switch (platform)
+    {
+        case Platform::SCHIP:
+            return 30;
+        case Platform::XOCHIP:
+            return 100;
+        default:
+            return 11;
+    }
+}
+
+void Chip8::unLoadROM() {
+
+    //Reset Memory (ROM)
+    memset(&memory[0x200], 0, sizeof(memory) - 0x200);
+    touchMemory(0x200, sizeof(memory) - 0x200);
+
+    //Reset Display (back to lo-res, plane 0)
+    hires = false;
+    planes = 1;
+    clearDisplay();
+    memset(rpl, 0, sizeof(rpl));
 
     //Reset Counters/Timers
     pc = 0x200;
@@ -145,190 +445,630 @@ void Chip8::unLoadROM() {
     sp = 0;
     sound_timer = 0x000;
     drawFlag = false;
+    frameStep = 0;
+    waitSkipped = 0;
+    idleSkipped = 0;
+    idleLoop.head = -1;
+
+    //History and call tree refer to the old program
+    journal.clear();
+    callGraph.reset(pc);
+
+    //Leave the debugger (breakpoints are kept)
+    debugger.paused = false;
+    debugger.reason = Debugger::StopReason::None;
+    debugger.resumePC = -1;
+
+    //Reset XO-CHIP Audio (Pattern + Pitch)
+    audio.reset(audioTime());
+
+}
+
+//One dispatch loop per combination of hooks, selected once per frame. With
+//hooks the quirks are read at run time (instrumented runs are slow anyway).
+template <size_t... Hooks>
+static constexpr std::array<void (Chip8::*)(), sizeof...(Hooks)> makeRunTable(std::index_sequence<Hooks...>) {
+    return {{ &Chip8::run<Hooks, QUIRKS_DYNAMIC>... }};
+}
+
+static constexpr std::array<void (Chip8::*)(), HOOK_COMBINATIONS> runTable = makeRunTable(std::make_index_sequence<HOOK_COMBINATIONS>());
 
+//Without hooks: one dispatch loop per compiled quirk profile
+template <size_t... Profiles>
+static constexpr std::array<void (Chip8::*)(), sizeof...(Profiles)> makeProfileRunTable(std::index_sequence<Profiles...>) {
+    return {{ &Chip8::run<0, quirkProfiles[Profiles]>... }};
 }
 
-void Chip8::cycle(){
+static constexpr std::array<void (Chip8::*)(), QUIRK_PROFILE_COUNT> profileRunTable = makeProfileRunTable(std::make_index_sequence<QUIRK_PROFILE_COUNT>());
 
+template <size_t... Hooks>
+static constexpr std::array<void (Chip8::*)(), sizeof...(Hooks)> makeExecuteTable(std::index_sequence<Hooks...>) {
+    return {{ &Chip8::execute<Hooks, QUIRKS_DYNAMIC>... }};
+}
 
-    unsigned short ipf = 11;
+static constexpr std::array<void (Chip8::*)(), HOOK_COMBINATIONS> executeTable = makeExecuteTable(std::make_index_sequence<HOOK_COMBINATIONS>());
+
+//Hooks needed by the current debugger/journal/profiler settings
+unsigned int Chip8::activeHooks() {
+    unsigned int hooks = 0;
+    if (debugger.armed()) {
+        hooks |= HOOK_DEBUG;
+    }
+    if (journal.enabled) {
+        hooks |= HOOK_JOURNAL;
+    }
+    if (profiler.enabled) {
+        hooks |= HOOK_PROFILE;
+    }
+    if (callGraph.enabled) {
+        hooks |= HOOK_CALLGRAPH;
+    }
+    if (tracer.recording()) {
+        hooks |= HOOK_TRACE;
+    }
+    return hooks;
+}
+
+//Run the rest of the current frame. Returns true when the frame is complete
+//(false when the debugger stopped it part way through).
+bool Chip8::cycle(){
 
     /*Note: When you add timers (the delay-timer and the sound-timer) 
     they need to be decremented outside that ipf loop or outside 
     cycle in the main frame-loop.*/
-    
+
+    unsigned int hooks = activeHooks();
+    if (hooks != 0) {
+        //Instructions run with hooks are not seen by the idle loop check
+        idleLoop.head = -1;
+    }
+    if (hooks == 0 && quirkProfile >= 0) {
+        (this->*profileRunTable[quirkProfile])();
+    } else {
+        (this->*runTable[hooks])();
+    }
+    return frameStep >= ipf;
+}
+
+//Execute a single instruction (debugger step). Returns true when it completed the frame.
+bool Chip8::step() {
+    (this->*executeTable[activeHooks() | HOOK_DEBUG])();
+    if (quirks.vblank && (lastOpcode & 0xF000) == 0xD000) {
+        waitSkipped += ipf - frameStep - 1;
+        frameStep = ipf - 1;
+    }
+    frameStep++;
+    debugger.resumePC = -1;
+    debugger.pause(Debugger::StopReason::Step, pc);
+    return frameStep >= ipf;
+}
+
+template <unsigned int Hooks, unsigned int QuirkBits>
+void Chip8::run() {
+
     //Instructions per Frame
-    while (ipf > 0)
+    for (; frameStep < ipf; frameStep++)
     {
-        //----FETCH----
-
-        //firstByte:     0000 0101
-        //Shift 8 bits : 0000 0101 0000 0000
-        //| secondByte:            0000 1010
-        //Result:        0000 0101 0000 1010
-        unsigned char firstByte = memory[pc];
-        unsigned char secondByte = memory[pc + 1];  
-        unsigned short opcode = (firstByte << 8) | secondByte;
-        lastOpcode = opcode;
-
-        //Get First Code from Opcode
-        //Opcode :              1010 0000 1111 0000  (0xAF0)
-        //& 0xF000:             1111 0000 0000 0000
-        //                      1010 0000 0000 0000
-        //Shift 12 bits:        0000 0000 0000 1010
-        unsigned short code = (opcode & 0xF000) >> 12;
-
-        //PRINT OPCODE
-        cout << hex << "Opcode: " << opcode << endl;
-
-        //Increment Program Counter
-        pc = pc + 2;
+        if (Hooks & HOOK_DEBUG) {
+            //Breakpoint (checked before the instruction runs)
+            if ((debugger.flags[pc] & Debugger::BREAK) && pc != debugger.resumePC && breakpointHit()) {
+                debugger.pause(Debugger::StopReason::Breakpoint, pc);
+                return;
+            }
+            debugger.resumePC = -1;
+        }
 
-        //----DECODE----
-        switch(code) 
-        {
+        unsigned short from = pc;
+        execute<Hooks, QuirkBits>();
 
-            case 0:
+        //Display Wait Quirk: DXYN ends the batch, the next instruction runs after
+        //the 60 Hz tick (the COSMAC VIP waited for the vertical blank to draw)
+        if (QuirkPolicy<QuirkBits>::vblank(quirks) && (lastOpcode & 0xF000) == 0xD000) {
+            waitSkipped += ipf - frameStep - 1;
+            frameStep = ipf - 1;
+        }
 
-                if ((opcode & 0x00FF) == 0xE0){ // CLS (Validated)
-                    graphics.clear(display);
-                } else if((opcode & 0x00FF) == 0xEE) { // RET
-                    sp--;
-                    pc = stack[sp];
-                }
-                break;
+        //Idle Loops (without hooks: skipped instructions would be missing from
+        //breakpoints, the journal, the profiles and the trace)
+        if (Hooks == 0 && idleSkip && ((lastOpcode & 0xF000) == 0x1000 || (lastOpcode & 0xF000) == 0xB000 ||
+                (lastOpcode & 0xF0FF) == 0xF00A)) {
+            skipIdle(from);
+        }
 
-            case 1: //(Validated)
-                //cout << "Jump" << endl;
+        if (Hooks & HOOK_DEBUG) {
+            //Watchpoint (the instruction that triggered it has completed)
+            if (debugger.paused) {
+                frameStep++;
+                return;
+            }
+        }
+    }
+}
 
-                //Extract Address from Opcode
-                //Opcode:   0001 0101 1010 0101  (0x15A5)
-                //&0x0FFF:  0000 1111 1111 1111 
-                //Result:   0000 0000 0101 1010
-                //Set Program Counter to Address
-                pc = (opcode & 0x0FFF);
-                break;
+//Idle Loops: nothing but register instructions between a short backward jump
+//and the next time round. When the registers, timers and stack are the same at
+//the second visit, every further turn is identical until the 60 Hz tick (the
+//delay timer and the keys only change between frames). Whole turns are
+//skipped; the rest of the frame runs as usual, so PC ends where the
+//interpreter would have left it.
+void Chip8::skipIdle(unsigned short from) {
+
+    //FX0A without a key: nothing happens before the next frame's input
+    if ((lastOpcode & 0xF0FF) == 0xF00A) {
+        if (pc == from) {
+            idleSkipped += ipf - frameStep - 1;
+            frameStep = ipf - 1;
+        }
+        return;
+    }
 
-            case 2: //CALL (Validated)
-                
-                stack[sp] = pc;
-                sp++;
-                pc = (opcode & 0x0FFF);
-                break;
+    //Any other jump (BNNN, forward or long) ends the loop being watched
+    if ((lastOpcode & 0xF000) != 0x1000 || pc > from || from - pc > IDLE_LOOP_BYTES) {
+        idleLoop.head = -1;
+        return;
+    }
 
-            case 3: //SE Vx, byte (Validated)
+    if (idleLoop.head == pc && idleLoop.jump == from && idleLoop.index == index && idleLoop.sp == sp &&
+            idleLoop.delay == delay_timer && idleLoop.sound == sound_timer && idleLoop.random == randomState &&
+            memcmp(idleLoop.v, v, sizeof(v)) == 0) {
+        if (idleBody(pc, from)) {
+            unsigned short length = frameStep - idleLoop.step;
+            unsigned short turns = (ipf - frameStep - 1) / length;
+            idleSkipped += turns * length;
+            frameStep += turns * length;
+        }
+        idleLoop.head = -1;
+        return;
+    }
 
-                if(v[(opcode & 0x0F00) >> 8] == (opcode & 0x00FF)) {
-                    pc = pc + 2; 
+    idleLoop.head = pc;
+    idleLoop.jump = from;
+    idleLoop.step = frameStep;
+    memcpy(idleLoop.v, v, sizeof(v));
+    idleLoop.index = index;
+    idleLoop.sp = sp;
+    idleLoop.delay = delay_timer;
+    idleLoop.sound = sound_timer;
+    idleLoop.random = randomState;
+}
+
+//True when the loop body only reads and writes registers (skips, loads, ALU,
+//key tests, FX07 and FX1E): one turn can't change anything outside them
+bool Chip8::idleBody(unsigned short head, unsigned short jump) {
+    for (unsigned int address = head; address < jump; address += 2)
+    {
+        unsigned short opcode = (memory[address] << 8) | memory[address + 1];
+        switch (opcode & 0xF000) {
+            case 0x3000:
+            case 0x4000:
+            case 0x6000:
+            case 0x7000:
+            case 0xA000:
+                break;
+            case 0x5000:
+            case 0x9000:
+                if ((opcode & 0x000F) != 0) {
+                    return false;
+                }
+                break;
+            case 0x8000:
+                if ((opcode & 0x000F) > 7 && (opcode & 0x000F) != 0xE) {
+                    return false;
+                }
+                break;
+            case 0xE000:
+                if ((opcode & 0x00FF) != 0x9E && (opcode & 0x00FF) != 0xA1) {
+                    return false;
+                }
+                break;
+            case 0xF000:
+                if ((opcode & 0x00FF) != 0x07 && (opcode & 0x00FF) != 0x1E) {
+                    return false;
                 }
                 break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+//Condition of the breakpoint at PC
+bool Chip8::breakpointHit() {
+    for (const Debugger::Breakpoint& breakpoint : debugger.breakpoints)
+    {
+        if (breakpoint.address == pc) {
+            return !breakpoint.conditional ||
+                Debugger::test(breakpoint.condition, v, index, delay_timer, sound_timer, sp);
+        }
+    }
+    return false;
+}
+
+template <unsigned int Hooks>
+inline unsigned char Chip8::readMemory(unsigned int address) {
+    address &= 0xFFFF;
+    if ((Hooks & HOOK_DEBUG) && (debugger.flags[address] & Debugger::WATCH_READ)) {
+        debugger.pause(Debugger::StopReason::WatchRead, address);
+    }
+    if (Hooks & HOOK_PROFILE) {
+        profiler.reads[address]++;
+    }
+    return memory[address];
+}
+
+template <unsigned int Hooks>
+inline void Chip8::writeMemory(unsigned int address, unsigned char value) {
+    address &= 0xFFFF;
+    if ((Hooks & HOOK_DEBUG) && (debugger.flags[address] & Debugger::WATCH_WRITE)) {
+        debugger.pause(Debugger::StopReason::WatchWrite, address);
+    }
+    if (Hooks & HOOK_PROFILE) {
+        profiler.writes[address]++;
+    }
+    memory[address] = value;
+    markWritten(address);
+}
+
+//Disassembly cache version + dirty bit for the hex editor
+inline void Chip8::markWritten(unsigned int address) {
+    pageVersion[address >> 8]++;
+    writtenMemory[address >> 6] |= 1ULL << (address & 63);
+}
+
+//Bytes stored by the frame or debugger step that just ran become the changed set
+void Chip8::latchWrites() {
+    memcpy(changedMemory, writtenMemory, sizeof(changedMemory));
+    memset(writtenMemory, 0, sizeof(writtenMemory));
+}
+
+bool Chip8::changedLastFrame(unsigned int address) {
+    address &= 0xFFFF;
+    return (changedMemory[address >> 6] >> (address & 63)) & 1;
+}
+
+//Memory edit from the UI (hex editor)
+void Chip8::poke(unsigned int address, unsigned char value) {
+    address &= 0xFFFF;
+    memory[address] = value;
+    markWritten(address);
+
+    //Recorded history can't be replayed over edited memory
+    journal.clear();
+}
+
+//Read memory without going through the hooks (UI, disassembler)
+unsigned char Chip8::peek(unsigned int address) {
+    return memory[address & 0xFFFF];
+}
+
+//Memory changed outside of the store opcodes (ROM load, undo)
+void Chip8::touchMemory(unsigned int address, unsigned int length) {
+    if (length == 0) {
+        return;
+    }
+    for (unsigned int page = address >> 8; page <= ((address + length - 1) >> 8) && page < 0x100; page++)
+    {
+        pageVersion[page]++;
+    }
+}
+
+template <unsigned int Hooks, unsigned int QuirkBits>
+void Chip8::execute() {
+
+    typedef QuirkPolicy<QuirkBits> Q;
+
+    //----FETCH----
+
+    //firstByte:     0000 0101
+    //Shift 8 bits : 0000 0101 0000 0000
+    //| secondByte:            0000 1010
+    //Result:        0000 0101 0000 1010
+    unsigned char firstByte = memory[pc];
+    unsigned char secondByte = memory[(pc + 1) & 0xFFFF];
+    unsigned short opcode = (firstByte << 8) | secondByte;
+    lastOpcode = opcode;
+
+    //Get First Code from Opcode
+    //Opcode :              1010 0000 1111 0000  (0xAF0)
+    //& 0xF000:             1111 0000 0000 0000
+    //                      1010 0000 0000 0000
+    //Shift 12 bits:        0000 0000 0000 1010
+    unsigned short code = (opcode & 0xF000) >> 12;
+
+    //Trace Points: matched on the state before the instruction
+    TraceRecord trace;
+    bool traced = (Hooks & HOOK_TRACE) && tracer.matches(pc, opcode, v, index, delay_timer, sound_timer, sp);
+    if ((Hooks & HOOK_TRACE) && traced) {
+        trace.frame = (unsigned int)frameCount;
+        trace.step = frameStep;
+        trace.pc = pc;
+        trace.opcode = opcode;
+        trace.index = index;
+        trace.vx = v[(opcode & 0x0F00) >> 8];
+        trace.vy = v[(opcode & 0x00F0) >> 4];
+    }
+
+    //Profiler: executions per PC and per opcode class
+    if (Hooks & HOOK_PROFILE) {
+        profiler.executions[pc]++;
+        profiler.classCount[Profiler::opcodeClass(opcode)]++;
+        profiler.total++;
+    }
+    if (Hooks & HOOK_CALLGRAPH) {
+        callGraph.sample();
+    }
+
+    //Undo Journal: save what this instruction is about to overwrite
+    if (Hooks & HOOK_JOURNAL) {
+        journalBegin(opcode);
+    }
 
-            case 4: //SNE Vx, byte (Validated)
+    //Increment Program Counter
+    pc = pc + 2;
 
-                if(v[(opcode & 0x0F00) >> 8] != (opcode & 0x00FF)) {
-                    pc = pc + 2; 
+    //----DECODE----
+    switch(code) 
+    {
+
+        case 0:
+
+            if ((opcode & 0x00FF) == 0xE0){ // CLS (Validated)
+                clearDisplay(planes);
+            } else if((opcode & 0x00FF) == 0xEE) { // RET
+                sp--;
+                pc = stack[sp];
+                if (Hooks & HOOK_CALLGRAPH) {
+                    callGraph.leave();
                 }
-                break;
+            } else if ((opcode & 0xFFF0) == 0x00C0) { // SCHIP: SCD nibble
+                scrollDown(opcode & 0x000F);
+            } else if ((opcode & 0xFFF0) == 0x00D0) { // XO-CHIP: SCU nibble
+                scrollUp(opcode & 0x000F);
+            } else if (opcode == 0x00FB) { // SCHIP: SCR (4 pixels)
+                scrollRight(4);
+            } else if (opcode == 0x00FC) { // SCHIP: SCL (4 pixels)
+                scrollLeft(4);
+            } else if (opcode == 0x00FD) { // SCHIP: EXIT (halt here)
+                pc = pc - 2;
+            } else if (opcode == 0x00FE) { // SCHIP: LOW
+                setResolution(false);
+            } else if (opcode == 0x00FF) { // SCHIP: HIGH
+                setResolution(true);
+            }
+            break;
+
+        case 1: //(Validated)
+            //cout << "Jump" << endl;
+
+            //Extract Address from Opcode
+            //Opcode:   0001 0101 1010 0101  (0x15A5)
+            //&0x0FFF:  0000 1111 1111 1111 
+            //Result:   0000 0000 0101 1010
+            //Set Program Counter to Address
+            pc = (opcode & 0x0FFF);
+            break;
+
+        case 2: //CALL (Validated)
+            
+            stack[sp] = pc;
+            sp++;
+            pc = (opcode & 0x0FFF);
+            if (Hooks & HOOK_CALLGRAPH) {
+                callGraph.enter(pc);
+            }
+            break;
+
+        case 3: //SE Vx, byte (Validated)
+
+            if(v[(opcode & 0x0F00) >> 8] == (opcode & 0x00FF)) {
+                skip();
+            }
+            break;
+
+        case 4: //SNE Vx, byte (Validated)
+
+            if(v[(opcode & 0x0F00) >> 8] != (opcode & 0x00FF)) {
+                skip();
+            }
+            break;
 
-            case 5: //SE Vx, Vy (Validated)
+        case 5:
 
+            if ((opcode & 0x000F) == 0) { // SE Vx, Vy (Validated)
                 if(v[(opcode & 0x0F00) >> 8] == v[(opcode & 0x00F0) >> 4]) {
-                    pc = pc + 2; 
+                    skip();
                 }
-                break;
+            } else if ((opcode & 0x000F) == 2 || (opcode & 0x000F) == 3) { // XO-CHIP: SAVE/LOAD Vx-Vy (I unchanged)
+                int x = (opcode & 0x0F00) >> 8;
+                int y = (opcode & 0x00F0) >> 4;
+                int direction = x <= y ? 1 : -1;
+                for (int i = 0; i <= (x <= y ? y - x : x - y); i++)
+                {
+                    if ((opcode & 0x000F) == 2) {
+                        writeMemory<Hooks>(index + i, v[x + i * direction]);
+                    } else {
+                        v[x + i * direction] = readMemory<Hooks>(index + i);
+                    }
+                }
+            }
+            break;
 
-            case 6: //LD Vx, byte (Validated)
-                //cout << "Set Register" << endl;
+        case 6: //LD Vx, byte (Validated)
+            //cout << "Set Register" << endl;
 
-                //Extract Register from Opcode
-                //Opcode:       0110 0001 1010 0101  (0x15A5)
-                //&0x0F00:      0000 1111 0000 0000
-                //              0000 0001 0000 0000
-                //Shift 8 bits: 0000 0000 0000 0001
+            //Extract Register from Opcode
+            //Opcode:       0110 0001 1010 0101  (0x15A5)
+            //&0x0F00:      0000 1111 0000 0000
+            //              0000 0001 0000 0000
+            //Shift 8 bits: 0000 0000 0000 0001
 
-                //Extract Value from Opcode
-                //Opcode:       0110 0001 1010 0101  (0x15A5)
-                //&0x00FF:      0000 0000 1111 1111
-                //              0000 0000 1010 0101
+            //Extract Value from Opcode
+            //Opcode:       0110 0001 1010 0101  (0x15A5)
+            //&0x00FF:      0000 0000 1111 1111
+            //              0000 0000 1010 0101
 
-                //Set Register
-                v[(opcode & 0x0F00) >> 8] = (opcode & 0x00FF);
-                break;
+            //Set Register
+            v[(opcode & 0x0F00) >> 8] = (opcode & 0x00FF);
+            break;
 
-            case 7: //ADD Vx, byte (Validated)
+        case 7: //ADD Vx, byte (Validated)
 
-                v[(opcode & 0x0F00) >> 8] = v[(opcode & 0x0F00) >> 8] + (opcode & 0x00FF);
-                break;
+            v[(opcode & 0x0F00) >> 8] = v[(opcode & 0x0F00) >> 8] + (opcode & 0x00FF);
+            break;
 
-            case 8:
+        case 8:
 
-                x8instructions(opcode);
-                break;
+            x8instructions<QuirkBits>(opcode);
+            break;
 
-            case 9: //SNE Vx, Vy (Validated)
+        case 9: //SNE Vx, Vy (Validated)
 
-                if(v[(opcode & 0x0F00) >> 8] != v[(opcode & 0x00F0) >> 4]){
-                    pc = pc + 2;
-                }
+            if(v[(opcode & 0x0F00) >> 8] != v[(opcode & 0x00F0) >> 4]){
+                skip();
+            }
 
-                break;
+            break;
 
-            case 0xA: //LD I, addr (Validated)
-                //cout << "Set Index" << endl;
+        case 0xA: //LD I, addr (Validated)
+            //cout << "Set Index" << endl;
 
-                //Set Index Register
-                index = (opcode & 0x0FFF);
-                break;
+            //Set Index Register
+            index = (opcode & 0x0FFF);
+            break;
 
-            case 0xB: // JP V0, addr (Validate)
+        case 0xB: // JP V0, addr (Validate)
 
-                pc = v[0] + (opcode & 0x0FFF);
-                break;
+            //Jump Quirk: BXNN jumps to XNN + VX
+            pc = v[Q::jump(quirks) ? (opcode & 0x0F00) >> 8 : 0] + (opcode & 0x0FFF);
+            break;
 
-            case 0xC: // RND Vx, byte ((Validated??)
+        case 0xC: // RND Vx, byte ((Validated??)
 
-                v[(opcode & 0x0F00) >> 8] = (rand() % 256) & (opcode & 0x00FF);
-                break;
+            v[(opcode & 0x0F00) >> 8] = nextRandom() & (opcode & 0x00FF);
+            break;
 
-            case 0xD: //(Validated)
+        case 0xD: //(Validated)
 
-                draw(opcode);
-                break;
+            draw<Hooks, QuirkBits>(opcode);
+            break;
 
-            case 0xE:
+        case 0xE:
 
-                if((opcode & 0x00FF) == 0x009E) { // SKP Vx
-                    if (v[(opcode & 0x0F00) >> 8] == pressedKey){
-                        pc = pc + 2;
-                    }
-                } else if((opcode & 0x00FF) == 0x00A1) { // SKNP Vx
-                    if (v[(opcode & 0x0F00) >> 8] != pressedKey){
-                        pc = pc + 2;
-                    }
+            if((opcode & 0x00FF) == 0x009E) { // SKP Vx
+                if (v[(opcode & 0x0F00) >> 8] == pressedKey){
+                    skip();
                 }
-                break;
+            } else if((opcode & 0x00FF) == 0x00A1) { // SKNP Vx
+                if (v[(opcode & 0x0F00) >> 8] != pressedKey){
+                    skip();
+                }
+            }
+            break;
 
-            case 0xF:
+        case 0xF:
 
-                xFinstructions(opcode);
-                break;
-            
-            default:
-                pushLog("Unknown instruction: " + opcode);
-                break; 
+            xFinstructions<Hooks, QuirkBits>(opcode);
+            break;
+        
+        default:
+            pushLog("Unknown instruction: " + opcodeText(opcode));
+            break; 
+    }
+
+    if (Hooks & HOOK_JOURNAL) {
+        journalEnd();
+    }
+
+    if ((Hooks & HOOK_TRACE) && traced) {
+        trace.nextPC = pc;
+        trace.result = v[(opcode & 0x0F00) >> 8];
+        trace.vf = v[0xF];
+        trace.sp = sp;
+        trace.flags = pc != ((trace.pc + 2) & 0xFFFF) ? TRACE_BRANCH : 0;
+        tracer.write(trace);
+    }
+}
+
+void Chip8::updateTimers() {
+
+    //Undo Journal: a frame boundary (timers are restored when stepping back over it)
+    if (journal.enabled) {
+        journal.begin(Journal::RECORD_FRAME, pc);
+        journal.put8(Journal::ENTRY_DELAY);
+        journal.put8(delay_timer);
+        journal.put8(Journal::ENTRY_SOUND);
+        journal.put8(sound_timer);
+        journal.commit(false);
+    }
+
+    //Delay Timer
+    if(delay_timer > 0) {
+        delay_timer--;
+    }
+
+    //Sound Timer
+    if(sound_timer > 0) {
+        sound_timer--;
+        if (sound_timer == 0) {
+            audio.setPlaying(false, audioTime());
         }
-        ipf--;
     }
+
+    frameCount++;
+    frameStep = 0;
+    lastWaitSkipped = waitSkipped;
+    waitSkipped = 0;
+    lastIdleSkipped = idleSkipped;
+    idleSkipped = 0;
+    idleLoop.head = -1;
+
+    //Gameplay recording: the frame just finished
+    if (recorder.recording()) {
+        recorder.capture(frameCount - 1, display, hires, graphics.palette, audio);
+    }
+    audio.flush(audioTime());
+}
+
+//Emulated time in audio samples (sub-frame accurate)
+unsigned long long Chip8::audioTime() {
+    return frameCount * audio.samplesPerFrame + (unsigned long long)frameStep * audio.samplesPerFrame / ipf;
 }
 
+template <unsigned int Hooks, unsigned int QuirkBits>
 void Chip8::xFinstructions(unsigned short opcode) {
 
     unsigned char h = 0;
     unsigned char t = 0;
     unsigned int value = 0;
+    unsigned char pattern[16];
 
     switch (opcode & 0x00FF)
     {
+        case 0x00: // XO-CHIP: LD I, NNNN (the address is the next word)
+
+            if (opcode == 0xF000 && platform == Platform::XOCHIP) {
+                index = (unsigned short)(memory[pc] << 8 | memory[(pc + 1) & 0xFFFF]);
+                pc = pc + 2;
+            } else {
+                pushLog("Couldn't find 0xF instruction: " + opcodeText(opcode));
+            }
+            break;
+
+        case 0x01: // XO-CHIP: PLANE N
+
+            planes = ((opcode & 0x0F00) >> 8) & ((1 << DISPLAY_PLANES) - 1);
+            break;
+
+        case 0x02: // XO-CHIP: LD AUDIO, [I] (16 byte pattern)
+
+            for (int i = 0; i < 16; i++)
+            {
+                pattern[i] = readMemory<Hooks>(index + i);
+            }
+            audio.setPattern(pattern, audioTime());
+            break;
+
         case 0x07: // LD Vx, DT
 
             v[(opcode & 0x0F00) >> 8] = delay_timer;
@@ -338,6 +1078,8 @@ void Chip8::xFinstructions(unsigned short opcode) {
 
             if(pressedKey == -1) {
                 pc = pc - 2;
+            } else {
+                v[(opcode & 0x0F00) >> 8] = (unsigned char)pressedKey;
             }
             break;
         
@@ -349,6 +1091,7 @@ void Chip8::xFinstructions(unsigned short opcode) {
         case 0x18: // LD ST, Vx
 
             sound_timer = v[(opcode & 0x0F00) >> 8];
+            audio.setPlaying(sound_timer > 0, audioTime());
             break;
 
         case 0x1E: // ADD I, Vx
@@ -361,42 +1104,84 @@ void Chip8::xFinstructions(unsigned short opcode) {
             index = v[(opcode & 0x0F00) >> 8] * 5;
             break;   
 
+        case 0x30: // SCHIP: LD HF, Vx (8x10 digit)
+
+            index = BIG_FONT + (v[(opcode & 0x0F00) >> 8] & 0xF) * 10;
+            break;
+
+        case 0x3A: // XO-CHIP: PITCH Vx
+
+            audio.setPitch(v[(opcode & 0x0F00) >> 8], audioTime());
+            break;
+
         case 0x33: // LD B, Vx  
 
-            memory[index]     = v[(opcode & 0x0F00) >> 8] / 100;
-            memory[index + 1] = (v[(opcode & 0x0F00) >> 8] / 10) % 10;
-            memory[index + 2] = v[(opcode & 0x0F00) >> 8] % 10; 
+            writeMemory<Hooks>(index,     v[(opcode & 0x0F00) >> 8] / 100);
+            writeMemory<Hooks>(index + 1, (v[(opcode & 0x0F00) >> 8] / 10) % 10);
+            writeMemory<Hooks>(index + 2, v[(opcode & 0x0F00) >> 8] % 10);
             break;
 
         case 0x55: // LD [I], Vx 
 
             value = index;
             for(int i = 0; i <= ((opcode & 0x0F00) >> 8); i++){
-                memory[index] = v[i];
+                writeMemory<Hooks>(index, v[i]);
                 index++;
             }
-            index = value;
+            restoreIndex<QuirkBits>(opcode, value);
             break;
 
         case 0x65: // LD Vx, [I]
 
             value = index;
             for(int i = 0; i <= ((opcode & 0x0F00) >> 8); i++){
-                v[i] = memory[index];
+                v[i] = readMemory<Hooks>(index);
                 index++;
             }
-            index = value;
+            restoreIndex<QuirkBits>(opcode, value);
+            break;
+
+        case 0x75: // SCHIP: LD R, Vx (save V0-VX in the RPL flags)
+
+            for (int i = 0; i <= ((opcode & 0x0F00) >> 8); i++)
+            {
+                rpl[i] = v[i];
+            }
+            break;
+
+        case 0x85: // SCHIP: LD Vx, R
+
+            for (int i = 0; i <= ((opcode & 0x0F00) >> 8); i++)
+            {
+                v[i] = rpl[i];
+            }
             break;
             
         default:
-            pushLog("Couldn't find 0xF instruction: " + opcode);
+            pushLog("Couldn't find 0xF instruction: " + opcodeText(opcode));
             break;
     }
 
 }
 
+//Load/Store Quirks: I is left at I + X + 1 (original), I + X or unchanged
+template <unsigned int QuirkBits>
+void Chip8::restoreIndex(unsigned short opcode, unsigned short start) {
+    typedef QuirkPolicy<QuirkBits> Q;
+    if (Q::memoryLeaveIUnchanged(quirks)) {
+        index = start;
+    } else if (Q::memoryIncrementByX(quirks)) {
+        index = start + ((opcode & 0x0F00) >> 8);
+    }
+}
+
+template <unsigned int QuirkBits>
 void Chip8::x8instructions(unsigned short opcode){
 
+   typedef QuirkPolicy<QuirkBits> Q;
+
+   unsigned char flag = 0;
+
    switch (opcode & 0x000F)
     {
         case 0: // LD Vx, Vy (Validated)
@@ -407,111 +1192,594 @@ void Chip8::x8instructions(unsigned short opcode){
         case 1: // OR Vx, Vy (Validated)
 
             v[(opcode & 0x0F00) >> 8] |= v[(opcode & 0x00F0) >> 4];
+            if (Q::logic(quirks)) {
+                v[15] = 0;
+            }
             break;
 
         case 2: // AND Vx, Vy (Validated)
 
             v[(opcode & 0x0F00) >> 8] &= v[(opcode & 0x00F0) >> 4];
+            if (Q::logic(quirks)) {
+                v[15] = 0;
+            }
             break;
 
         case 3: // XOR Vx, Vy (Validated)
 
             v[(opcode & 0x0F00) >> 8] ^= v[(opcode & 0x00F0) >> 4];
+            if (Q::logic(quirks)) {
+                v[15] = 0;
+            }
             break;
 
         case 4: //ADD Vx, Vy (Validated)
 
+            //Flags from the operands, written last (VF can be VX)
+            flag = v[(opcode & 0x0F00) >> 8] + v[(opcode & 0x00F0) >> 4] > 255 ? 1 : 0;
             v[(opcode & 0x0F00) >> 8] = v[(opcode & 0x0F00) >> 8] + v[(opcode & 0x00F0) >> 4];
-            v[15] = v[(opcode & 0x0F00) >> 8] + v[(opcode & 0x00F0) >> 4] > 255 ? 1 : 0;
+            v[15] = flag;
             break;
 
         case 5: // SUB Vx, Vy (Validated)
 
+            flag = v[(opcode & 0x00F0) >> 4] > v[(opcode & 0x0F00) >> 8] ? 0 : 1;
             v[(opcode & 0x0F00) >> 8] = v[(opcode & 0x0F00) >> 8] - v[(opcode & 0x00F0) >> 4];
-            v[15] = v[(opcode & 0x00F0) >> 4] > v[(opcode & 0x0F00) >> 8] ? 0 : 1;
+            v[15] = flag;
             break;
 
         case 6: //SHR Vx {, Vy} (Validated)
 
-            v[15] = v[(opcode & 0x0F00) >> 8] & 0x01;
-            v[(opcode & 0x0F00) >> 8] >>= 1;
+            //Shift Quirk: shift VX in place instead of VY
+            flag = v[Q::shift(quirks) ? (opcode & 0x0F00) >> 8 : (opcode & 0x00F0) >> 4];
+            v[(opcode & 0x0F00) >> 8] = flag >> 1;
+            v[15] = flag & 0x01;
             break;
 
         case 7: //  SUBN Vx, Vy (Validated)
 
+            flag = v[(opcode & 0x0F00) >> 8] > v[(opcode & 0x00F0) >> 4] ? 0 : 1;
             v[(opcode & 0x0F00) >> 8] = v[(opcode & 0x00F0) >> 4] - v[(opcode & 0x0F00) >> 8];
-            v[15] = v[(opcode & 0x00F0) >> 4] > v[(opcode & 0x0F00) >> 8] ? 1 : 0;
+            v[15] = flag;
             break;
 
         case 0xE: //SHL Vx {, Vy} (Validated)
 
-            v[15] = (v[(opcode & 0x00F0) >> 4] >> 7) & 0x1;
-            v[(opcode & 0x0F00) >> 8] <<= 1;
+            flag = v[Q::shift(quirks) ? (opcode & 0x0F00) >> 8 : (opcode & 0x00F0) >> 4];
+            v[(opcode & 0x0F00) >> 8] = flag << 1;
+            v[15] = (flag >> 7) & 0x1;
             break;
 
         default:
-            pushLog("Couldn't find 0x8 instruction: " + opcode);
+            pushLog("Couldn't find 0x8 instruction: " + opcodeText(opcode));
             break;
     }
 
 }
 
+template <unsigned int Hooks, unsigned int QuirkBits>
 void Chip8::draw(unsigned short opcode) {
 
-    unsigned short coordX;
-    unsigned short coordY;
-    unsigned short rows;
-    unsigned char spriteRow;
-
-    //Extract X and Y coordinates from VX and VY
-    coordX = v[(opcode & 0x0F00) >> 8] % 64;
-    coordY = v[(opcode & 0x00F0) >> 4] % 32;
-
-    const unsigned short orgX = coordX;
-
-    //V15 = 0
-    v[0xF] = 0x0;
-
     //Extract Nth Byte from Memory
     //D01F -> 1101 0000 0001 1111
     //& 0x000F -> 0000 0000 0000 1111
     //Result: 0000 1111 (15)
-    rows = opcode & 0x000F;
+    //DXY0 (SUPER-CHIP) draws a 16 x 16 sprite, two bytes per row
+    const int bytes = (opcode & 0x000F) == 0 ? 32 : opcode & 0x000F;
+
+    //XO-CHIP: the sprite of each selected plane follows the previous one
+    unsigned char collisions = 0;
+    unsigned short address = index;
+    for (int plane = 0; plane < DISPLAY_PLANES; plane++)
+    {
+        if (planes & (1 << plane)) {
+            drawPlane<Hooks, QuirkBits>(plane, opcode, address, collisions);
+            address += bytes;
+        }
+    }
+
+    //SUPER-CHIP hi-res: VF counts the rows that collided or were clipped at the bottom
+    v[0xF] = platform == Platform::SCHIP && hires ? collisions : (collisions > 0 ? 1 : 0);
+    drawFlag = true;
+}
+
+//XOR one sprite into a plane, counting the rows that collided
+template <unsigned int Hooks, unsigned int QuirkBits>
+void Chip8::drawPlane(int plane, unsigned short opcode, unsigned short address, unsigned char& collisions) {
+
+    typedef QuirkPolicy<QuirkBits> Q;
+
+    const int width = displayWidth();
+    const int height = displayHeight();
+
+    //The origin wraps, the sprite itself clips (or wraps with the quirk)
+    const int orgX = v[(opcode & 0x0F00) >> 8] % width;
+    const int orgY = v[(opcode & 0x00F0) >> 4] % height;
+
+    int rows = opcode & 0x000F;
+    const bool wide = rows == 0;
+    if (wide) {
+        rows = 16;
+    }
+
+    const int word = orgX >> 6;
+    const int shift = orgX & 63;
+    const int words = width / 64;
 
     for (int i = 0; i < rows; i++)
     {
-        coordX = orgX;
-        spriteRow = memory[index + i];
-        for (int j = 0; j < 8; j++)
+        //Wrap Quirk: sprites wrap around the edges instead of clipping
+        int y = orgY + i;
+        if (y >= height) {
+            if (!Q::wrap(quirks)) {
+                if (platform == Platform::SCHIP && hires) {
+                    collisions += rows - i;
+                }
+                break;
+            }
+            y %= height;
+        }
+
+        //Sprite row in the top bits of a word, then shifted into place across the
+        //row words. overflow holds what ends up past the right edge.
+        unsigned long long sprite;
+        if (wide) {
+            sprite = (unsigned long long)readMemory<Hooks>(address + i * 2) << 56 |
+                     (unsigned long long)readMemory<Hooks>(address + i * 2 + 1) << 48;
+        } else {
+            sprite = (unsigned long long)readMemory<Hooks>(address + i) << 56;
+        }
+
+        unsigned long long mask[DISPLAY_WORDS] = {};
+        unsigned long long overflow = shift ? sprite << (64 - shift) : 0;
+        mask[word] = sprite >> shift;
+        if (word + 1 < words) {
+            mask[word + 1] = overflow;
+            overflow = 0;
+        }
+        if (Q::wrap(quirks)) {
+            mask[0] |= overflow;
+        }
+
+        bool collided = false;
+        for (int w = 0; w < words; w++)
+        {
+            collided |= (display[plane][y][w] & mask[w]) != 0;
+            display[plane][y][w] ^= mask[w];
+        }
+        if (collided) {
+            collisions++;
+        }
+    }
+}
+
+//----SUPER-CHIP/XO-CHIP Scrolling (selected planes; whole words, carrying bits
+//between the two halves of a row)----
+
+void Chip8::scrollDown(int rows) {
+    for (int plane = 0; plane < DISPLAY_PLANES; plane++)
+    {
+        if (!(planes & (1 << plane))) {
+            continue;
+        }
+        for (int y = displayHeight() - 1; y >= 0; y--)
         {
-            if(coordX < 64 && coordY < 32) //Check for bounds
-            { 
-                unsigned int pixel = (spriteRow >> 7 - j) & 1;
+            for (int w = 0; w < DISPLAY_WORDS; w++)
+            {
+                display[plane][y][w] = y >= rows ? display[plane][y - rows][w] : 0;
+            }
+        }
+    }
+    drawFlag = true;
+}
 
-                if (pixel)
+void Chip8::scrollUp(int rows) {
+    int height = displayHeight();
+    for (int plane = 0; plane < DISPLAY_PLANES; plane++)
+    {
+        if (!(planes & (1 << plane))) {
+            continue;
+        }
+        for (int y = 0; y < height; y++)
+        {
+            for (int w = 0; w < DISPLAY_WORDS; w++)
+            {
+                display[plane][y][w] = y + rows < height ? display[plane][y + rows][w] : 0;
+            }
+        }
+    }
+    drawFlag = true;
+}
+
+void Chip8::scrollRight(int pixels) {
+    int words = displayWidth() / 64;
+    for (int plane = 0; plane < DISPLAY_PLANES; plane++)
+    {
+        if (!(planes & (1 << plane))) {
+            continue;
+        }
+        for (int y = 0; y < displayHeight(); y++)
+        {
+            unsigned long long* row = display[plane][y];
+            for (int w = words - 1; w > 0; w--)
+            {
+                row[w] = (row[w] >> pixels) | (row[w - 1] << (64 - pixels));
+            }
+            row[0] >>= pixels;
+        }
+    }
+    drawFlag = true;
+}
+
+void Chip8::scrollLeft(int pixels) {
+    int words = displayWidth() / 64;
+    for (int plane = 0; plane < DISPLAY_PLANES; plane++)
+    {
+        if (!(planes & (1 << plane))) {
+            continue;
+        }
+        for (int y = 0; y < displayHeight(); y++)
+        {
+            unsigned long long* row = display[plane][y];
+            for (int w = 0; w < words - 1; w++)
+            {
+                row[w] = (row[w] << pixels) | (row[w + 1] >> (64 - pixels));
+            }
+            row[words - 1] <<= pixels;
+        }
+    }
+    drawFlag = true;
+}
+
+//----Undo Journal (Reverse Execution)----
+
+void Chip8::journalV(unsigned char x) {
+    journal.put8(Journal::ENTRY_V + x);
+    journal.put8(v[x]);
+}
+
+void Chip8::journalIndex() {
+    journal.put8(Journal::ENTRY_INDEX);
+    journal.put16(index);
+}
+
+void Chip8::journalMemory(unsigned int address) {
+    journal.put8(Journal::ENTRY_MEMORY);
+    journal.put16((unsigned short)address);
+    journal.put8(memory[address & 0xFFFF]);
+}
+
+void Chip8::journalRow(int y) {
+    journalRows[journalRowCount] = (unsigned char)y;
+    for (int plane = 0; plane < DISPLAY_PLANES; plane++)
+    {
+        memcpy(journalMasks[journalRowCount][plane], display[plane][y], sizeof(display[plane][y]));
+    }
+    journalRowCount++;
+}
+
+//Record the old value of everything the instruction will overwrite
+void Chip8::journalBegin(unsigned short opcode) {
+
+    unsigned char x = (opcode & 0x0F00) >> 8;
+    unsigned char y = (opcode & 0x00F0) >> 4;
+
+    journal.begin(Journal::RECORD_INSTRUCTION, pc);
+    journalRowCount = 0;
+
+    switch (opcode >> 12)
+    {
+        case 0x0:
+            if (opcode == 0x00E0 || (opcode & 0xFFE0) == 0x00C0 || (opcode >= 0x00FB && opcode <= 0x00FF)) {
+                //CLS, scrolling and resolution changes touch the whole screen
+                for (int y = 0; y < DISPLAY_ROWS; y++)
                 {
-                    if(display[coordX][coordY] == 1)
+                    journalRow(y);
+                }
+                if (opcode >= 0x00FE) {
+                    journal.put8(Journal::ENTRY_HIRES);
+                    journal.put8(hires);
+                }
+            } else if (opcode == 0x00EE) {
+                journal.put8(Journal::ENTRY_SP);
+                journal.put8(sp);
+            }
+            break;
+
+        case 0x2:
+            journal.put8(Journal::ENTRY_SP);
+            journal.put8(sp);
+            journal.put8(Journal::ENTRY_STACK);
+            journal.put8(sp & 0xF);
+            journal.put16(stack[sp & 0xF]);
+            break;
+
+        case 0x5:
+            for (int i = 0; i <= (x <= y ? y - x : x - y); i++)
+            {
+                if ((opcode & 0x000F) == 2) {
+                    journalMemory(index + i);
+                } else if ((opcode & 0x000F) == 3) {
+                    journalV(x <= y ? x + i : x - i);
+                }
+            }
+            break;
+
+        case 0x6:
+        case 0x7:
+        case 0xC:
+            journalV(x);
+            break;
+
+        case 0x8:
+            journalV(x);
+            journalV(0xF);
+            break;
+
+        case 0xA:
+            journalIndex();
+            break;
+
+        case 0xD:
+            journalV(0xF);
+            for (int i = 0; i < ((opcode & 0x000F) == 0 ? 16 : (opcode & 0x000F)); i++)
+            {
+                journalRow((v[(opcode & 0x00F0) >> 4] + i) % displayHeight());
+            }
+            break;
+
+        case 0xF:
+            switch (opcode & 0x00FF)
+            {
+                case 0x00:
+                    journalIndex();
+                    break;
+                case 0x01:
+                    journal.put8(Journal::ENTRY_PLANES);
+                    journal.put8(planes);
+                    break;
+                case 0x07:
+                case 0x0A:
+                    journalV(x);
+                    break;
+                case 0x15:
+                    journal.put8(Journal::ENTRY_DELAY);
+                    journal.put8(delay_timer);
+                    break;
+                case 0x18:
+                    journal.put8(Journal::ENTRY_SOUND);
+                    journal.put8(sound_timer);
+                    break;
+                case 0x1E:
+                case 0x29:
+                case 0x30:
+                    journalIndex();
+                    break;
+                case 0x33:
+                    for (int i = 0; i < 3; i++)
                     {
-                        v[15] = 1;
-                        display[coordX][coordY] = 0;
-                    } else {
-                        display[coordX][coordY] = 1;
-                    } 
+                        journalMemory(index + i);
+                    }
+                    break;
+                case 0x55:
+                    for (int i = 0; i <= x; i++)
+                    {
+                        journalMemory(index + i);
+                    }
+                    journalIndex();
+                    break;
+                case 0x65:
+                    for (int i = 0; i <= x; i++)
+                    {
+                        journalV(i);
+                    }
+                    journalIndex();
+                    break;
+                case 0x75:
+                    for (int i = 0; i <= x; i++)
+                    {
+                        journal.put8(Journal::ENTRY_RPL);
+                        journal.put8(i);
+                        journal.put8(rpl[i]);
+                    }
+                    break;
+                case 0x85:
+                    for (int i = 0; i <= x; i++)
+                    {
+                        journalV(i);
+                    }
+                    break;
+            }
+            break;
+    }
+}
+
+//Display XOR deltas, then store the record
+void Chip8::journalEnd() {
+    for (int i = 0; i < journalRowCount; i++)
+    {
+        for (int plane = 0; plane < DISPLAY_PLANES; plane++)
+        {
+            for (int w = 0; w < DISPLAY_WORDS; w++)
+            {
+                unsigned long long delta = journalMasks[i][plane][w] ^ display[plane][journalRows[i]][w];
+                if (delta != 0) {
+                    journal.put8(Journal::ENTRY_DISPLAY);
+                    journal.put8(journalRows[i]);
+                    journal.put8(plane * DISPLAY_WORDS + w);
+                    journal.put64(delta);
                 }
-                coordX++;
-            } 
+            }
         }
-        coordY++;
     }
+    journal.commit(pc != (unsigned short)(journal.startPC() + 2));
+}
 
-    drawFlag = true;
+//Undo the newest journal record. watchHit is set when the undone
+//instruction touched a watched address (reverse watchpoints).
+bool Chip8::undo(bool& watchHit) {
+
+    unsigned char record[Journal::MAX_RECORD];
+    size_t length;
+    if (!journal.pop(record, length)) {
+        return false;
+    }
+
+    unsigned char type = record[0];
+    size_t at = 1;
+    unsigned short previousPC = pc - 2;
+    if (type & Journal::RECORD_HAS_PC) {
+        previousPC = (unsigned short)(record[1] << 8 | record[2]);
+        at = 3;
+    }
+
+    //Put the old values back
+    while (at < length)
+    {
+        unsigned char tag = record[at++];
+        if (tag < 0x10) {
+            v[tag] = record[at++];
+            continue;
+        }
+
+        switch (tag)
+        {
+            case Journal::ENTRY_INDEX:
+                index = (unsigned short)(record[at] << 8 | record[at + 1]);
+                at += 2;
+                break;
+            case Journal::ENTRY_SP:
+                sp = record[at++];
+                break;
+            case Journal::ENTRY_STACK:
+                stack[record[at] & 0xF] = (unsigned short)(record[at + 1] << 8 | record[at + 2]);
+                at += 3;
+                break;
+            case Journal::ENTRY_DELAY:
+                delay_timer = record[at++];
+                break;
+            case Journal::ENTRY_SOUND:
+                sound_timer = record[at++];
+                break;
+            case Journal::ENTRY_MEMORY: {
+                unsigned short address = (unsigned short)(record[at] << 8 | record[at + 1]);
+                memory[address] = record[at + 2];
+                markWritten(address);
+                if (debugger.flags[address] & Debugger::WATCH_WRITE) {
+                    debugger.pause(Debugger::StopReason::WatchWrite, address);
+                    watchHit = true;
+                }
+                at += 3;
+                break;
+            }
+            case Journal::ENTRY_DISPLAY: {
+                int y = record[at] % DISPLAY_ROWS;
+                int plane = record[at + 1] / DISPLAY_WORDS % DISPLAY_PLANES;
+                int w = record[at + 1] % DISPLAY_WORDS;
+                unsigned long long delta = 0;
+                for (int i = 0; i < 8; i++)
+                {
+                    delta = (delta << 8) | record[at + 2 + i];
+                }
+                display[plane][y][w] ^= delta;
+                drawFlag = true;
+                at += 10;
+                break;
+            }
+            case Journal::ENTRY_HIRES:
+                hires = record[at++] != 0;
+                drawFlag = true;
+                break;
+            case Journal::ENTRY_RPL:
+                rpl[record[at] & 0xF] = record[at + 1];
+                at += 2;
+                break;
+            case Journal::ENTRY_PLANES:
+                planes = record[at++];
+                break;
+            default:
+                at = length;
+                break;
+        }
+    }
+
+    if ((type & 0x7F) == Journal::RECORD_FRAME) {
+        frameCount--;
+        frameStep = ipf;
+        audio.setPlaying(sound_timer > 0, audioTime());
+        return true;
+    }
+
+    pc = previousPC;
+    if (frameStep > 0) {
+        frameStep--;
+    }
+
+    //Reverse read watchpoints: what the restored instruction reads
+    unsigned short opcode = (unsigned short)(memory[pc] << 8 | memory[(pc + 1) & 0xFFFF]);
+    unsigned int readLength = 0;
+    if ((opcode & 0xF000) == 0xD000) {
+        readLength = (opcode & 0x000F) == 0 ? 32 : opcode & 0x000F;
+        readLength *= (planes & 1) + ((planes >> 1) & 1);
+    } else if ((opcode & 0xF00F) == 0x5003) {
+        unsigned int x = (opcode & 0x0F00) >> 8;
+        unsigned int y = (opcode & 0x00F0) >> 4;
+        readLength = (x <= y ? y - x : x - y) + 1;
+    } else if ((opcode & 0xF0FF) == 0xF065) {
+        readLength = ((opcode & 0x0F00) >> 8) + 1;
+    } else if (opcode == 0xF002) {
+        readLength = 16;
+    }
+    for (unsigned int i = 0; i < readLength; i++)
+    {
+        unsigned short address = (unsigned short)(index + i);
+        if (debugger.flags[address] & Debugger::WATCH_READ) {
+            debugger.pause(Debugger::StopReason::WatchRead, address);
+            watchHit = true;
+            break;
+        }
+    }
+    return true;
+}
+
+//Step back one instruction (frame boundaries are undone on the way)
+bool Chip8::stepBack() {
+    bool watchHit = false;
+    while (undo(watchHit))
+    {
+        if (frameStep < ipf) {
+            debugger.pause(Debugger::StopReason::Step, pc);
+            return true;
+        }
+    }
+    return false;
+}
+
+//Run backwards until a breakpoint, a reverse watchpoint or the start of the history
+bool Chip8::reverseContinue() {
+    bool moved = false;
+    bool watchHit = false;
+    while (undo(watchHit))
+    {
+        moved = true;
+        if (watchHit) {
+            return true;
+        }
+        if (frameStep < ipf && (debugger.flags[pc] & Debugger::BREAK) && breakpointHit()) {
+            debugger.pause(Debugger::StopReason::Breakpoint, pc);
+            return true;
+        }
+    }
+    debugger.pause(Debugger::StopReason::User, pc);
+    return moved;
 }
 
 void Chip8::updateDisplay() {
-    graphics.drawDisplay(display);
+    graphics.drawDisplay(display, displayWidth(), displayHeight());
 }
 
 void Chip8::destroyGraphics() {
+    audio.close();
     SDL_DestroyRenderer(graphics.renderer);
     SDL_DestroyWindow(graphics.window);
     SDL_DestroyTexture(graphics.texture);
@@ -0,0 +1,242 @@
+#include <debugger.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <sstream>
+
+
+Debugger::Debugger() {
+    paused = false;
+    reason = StopReason::None;
+    stopAddress = 0;
+    resumePC = -1;
+}
+
+//Anything that needs the debug dispatch loop
+bool Debugger::armed() {
+    return !breakpoints.empty() || !watchpoints.empty();
+}
+
+bool Debugger::addBreakpoint(unsigned short address, const std::string& condition, std::string& error) {
+
+    Breakpoint breakpoint;
+    breakpoint.address = address;
+    breakpoint.conditional = false;
+    breakpoint.text = condition;
+
+    //Empty condition: always break
+    size_t start = condition.find_first_not_of(" \t");
+    if (start != std::string::npos) {
+        if (!parseCondition(condition, breakpoint.condition, error)) {
+            return false;
+        }
+        breakpoint.conditional = true;
+    }
+
+    //One breakpoint per address (replace)
+    removeBreakpoint(address);
+    breakpoints.push_back(breakpoint);
+    flags[address] |= BREAK;
+    return true;
+}
+
+void Debugger::removeBreakpoint(unsigned short address) {
+    for (size_t i = 0; i < breakpoints.size(); i++)
+    {
+        if (breakpoints[i].address == address) {
+            breakpoints.erase(breakpoints.begin() + i);
+            break;
+        }
+    }
+    flags[address] &= ~BREAK;
+}
+
+void Debugger::addWatchpoint(unsigned short address, unsigned short length, unsigned char mode) {
+    Watchpoint watchpoint;
+    watchpoint.address = address;
+    watchpoint.length = length > 0 ? length : 1;
+    watchpoint.mode = mode & (WATCH_READ | WATCH_WRITE);
+    watchpoints.push_back(watchpoint);
+    rebuildWatchFlags();
+}
+
+void Debugger::removeWatchpoint(size_t i) {
+    if (i < watchpoints.size()) {
+        watchpoints.erase(watchpoints.begin() + i);
+        rebuildWatchFlags();
+    }
+}
+
+void Debugger::clear() {
+    breakpoints.clear();
+    watchpoints.clear();
+    for (unsigned int i = 0; i < 0x10000; i++)
+    {
+        flags[i] = 0;
+    }
+}
+
+//Watch ranges can overlap, so the watch bits are recomputed from the list
+void Debugger::rebuildWatchFlags() {
+    for (unsigned int i = 0; i < 0x10000; i++)
+    {
+        flags[i] &= BREAK;
+    }
+    for (const Watchpoint& watchpoint : watchpoints)
+    {
+        for (unsigned int i = 0; i < watchpoint.length; i++)
+        {
+            flags[(watchpoint.address + i) & 0xFFFF] |= watchpoint.mode;
+        }
+    }
+}
+
+void Debugger::pause(StopReason why, unsigned short address) {
+    paused = true;
+    reason = why;
+    stopAddress = address;
+}
+
+void Debugger::resume(unsigned short pc) {
+    paused = false;
+    reason = StopReason::None;
+
+    //Don't stop again on the breakpoint we are sitting on
+    resumePC = pc;
+}
+
+std::string Debugger::describeStop() {
+    char text[64];
+    switch (reason)
+    {
+        case StopReason::Breakpoint:
+            snprintf(text, sizeof(text), "Breakpoint at %03X", stopAddress);
+            break;
+        case StopReason::WatchRead:
+            snprintf(text, sizeof(text), "Read watchpoint at %03X", stopAddress);
+            break;
+        case StopReason::WatchWrite:
+            snprintf(text, sizeof(text), "Write watchpoint at %03X", stopAddress);
+            break;
+        case StopReason::Step:
+            snprintf(text, sizeof(text), "Stepped to %03X", stopAddress);
+            break;
+        case StopReason::User:
+            snprintf(text, sizeof(text), "Paused at %03X", stopAddress);
+            break;
+        default:
+            snprintf(text, sizeof(text), "Running");
+            break;
+    }
+    return text;
+}
+
+static bool parseOperand(const std::string& token, Debugger::Operand& operand) {
+
+    std::string upper = token;
+    for (char& c : upper)
+    {
+        c = (char)toupper((unsigned char)c);
+    }
+
+    if (upper.size() == 2 && upper[0] == 'V' && isxdigit((unsigned char)upper[1])) {
+        operand.kind = Debugger::Operand::Register;
+        operand.value = (unsigned short)strtoul(upper.c_str() + 1, nullptr, 16);
+        return true;
+    }
+    if (upper == "I") {
+        operand.kind = Debugger::Operand::Index;
+        return true;
+    }
+    if (upper == "DT") {
+        operand.kind = Debugger::Operand::Delay;
+        return true;
+    }
+    if (upper == "ST") {
+        operand.kind = Debugger::Operand::Sound;
+        return true;
+    }
+    if (upper == "SP") {
+        operand.kind = Debugger::Operand::StackPointer;
+        return true;
+    }
+
+    //Number (0x10, 16, $10)
+    const char* digits = upper.c_str();
+    int base = 10;
+    if (upper.compare(0, 2, "0X") == 0) {
+        digits += 2;
+        base = 16;
+    } else if (upper[0] == '$') {
+        digits += 1;
+        base = 16;
+    }
+    char* end;
+    unsigned long value = strtoul(digits, &end, base);
+    if (*digits == 0 || *end != 0 || value > 0xFFFF) {
+        return false;
+    }
+    operand.kind = Debugger::Operand::Constant;
+    operand.value = (unsigned short)value;
+    return true;
+}
+
+bool Debugger::parseCondition(const std::string& text, Condition& condition, std::string& error) {
+
+    static const char* ops[] = { "==", "!=", "<=", ">=", "<", ">" };
+
+    //Split around the operator
+    for (const char* op : ops)
+    {
+        size_t at = text.find(op);
+        if (at == std::string::npos) {
+            continue;
+        }
+
+        std::string left;
+        std::string right;
+        std::istringstream(text.substr(0, at)) >> left;
+        std::istringstream(text.substr(at + std::string(op).size())) >> right;
+
+        if (!parseOperand(left, condition.left)) {
+            error = "Bad operand: " + left;
+            return false;
+        }
+        if (!parseOperand(right, condition.right)) {
+            error = "Bad operand: " + right;
+            return false;
+        }
+        condition.op = op;
+        return true;
+    }
+
+    error = "Expected a comparison (==, !=, <, <=, >, >=)";
+    return false;
+}
+
+static unsigned short operandValue(const Debugger::Operand& operand, const unsigned char v[16], unsigned short index,
+                                   unsigned char delay, unsigned char sound, unsigned char sp) {
+    switch (operand.kind)
+    {
+        case Debugger::Operand::Register:     return v[operand.value & 0xF];
+        case Debugger::Operand::Index:        return index;
+        case Debugger::Operand::Delay:        return delay;
+        case Debugger::Operand::Sound:        return sound;
+        case Debugger::Operand::StackPointer: return sp;
+        default:                              return operand.value;
+    }
+}
+
+bool Debugger::test(const Condition& condition, const unsigned char v[16], unsigned short index,
+                    unsigned char delay, unsigned char sound, unsigned char sp) {
+
+    unsigned short a = operandValue(condition.left, v, index, delay, sound, sp);
+    unsigned short b = operandValue(condition.right, v, index, delay, sound, sp);
+
+    if (condition.op == "==") return a == b;
+    if (condition.op == "!=") return a != b;
+    if (condition.op == "<=") return a <= b;
+    if (condition.op == ">=") return a >= b;
+    if (condition.op == "<")  return a < b;
+    return a > b;
+}
@@ -0,0 +1,141 @@
+#include <disassembler.h>
+#include <stdio.h>
+
+
+Disassembler::Disassembler() {
+    cache.resize(0x10000);
+    clear();
+}
+
+void Disassembler::clear() {
+    for (Line& line : cache)
+    {
+        line.valid = false;
+    }
+}
+
+//Cached line at address (decoded again when its memory pages were written)
+const Disassembler::Line& Disassembler::line(Chip8& chip8, unsigned short address) {
+
+    Line& line = cache[address];
+    bool xochip = chip8.platform == Platform::XOCHIP;
+    unsigned int version = chip8.pageVersion[address >> 8];
+    unsigned int nextVersion = chip8.pageVersion[((address + 3) & 0xFFFF) >> 8];
+
+    if (line.valid && line.xochip == xochip && line.version == version && line.nextVersion == nextVersion) {
+        return line;
+    }
+
+    unsigned short opcode = (unsigned short)(chip8.peek(address) << 8 | chip8.peek(address + 1));
+    unsigned short next = (unsigned short)(chip8.peek(address + 2) << 8 | chip8.peek(address + 3));
+    line.text = decode(opcode, next, xochip, line.length);
+    line.xochip = xochip;
+    line.version = version;
+    line.nextVersion = nextVersion;
+    line.valid = true;
+    return line;
+}
+
+std::string Disassembler::decode(unsigned short opcode, unsigned short next, bool xochip, unsigned char& length) {
+
+    char text[32];
+    unsigned int x = (opcode & 0x0F00) >> 8;
+    unsigned int y = (opcode & 0x00F0) >> 4;
+    unsigned int n = opcode & 0x000F;
+    unsigned int nn = opcode & 0x00FF;
+    unsigned int nnn = opcode & 0x0FFF;
+    length = 2;
+
+    switch (opcode >> 12)
+    {
+        case 0x0:
+            if (opcode == 0x00E0) return "CLS";
+            if (opcode == 0x00EE) return "RET";
+            if (opcode == 0x00FB) return "SCR";
+            if (opcode == 0x00FC) return "SCL";
+            if (opcode == 0x00FD) return "EXIT";
+            if (opcode == 0x00FE) return "LOW";
+            if (opcode == 0x00FF) return "HIGH";
+            if ((opcode & 0xFFF0) == 0x00C0) {
+                snprintf(text, sizeof(text), "SCD %X", n);
+            } else if ((opcode & 0xFFF0) == 0x00D0) {
+                snprintf(text, sizeof(text), "SCU %X", n);
+            } else {
+                snprintf(text, sizeof(text), "SYS #%03X", nnn);
+            }
+            break;
+        case 0x1: snprintf(text, sizeof(text), "JP #%03X", nnn); break;
+        case 0x2: snprintf(text, sizeof(text), "CALL #%03X", nnn); break;
+        case 0x3: snprintf(text, sizeof(text), "SE V%X, #%02X", x, nn); break;
+        case 0x4: snprintf(text, sizeof(text), "SNE V%X, #%02X", x, nn); break;
+        case 0x5:
+            if (n == 0x0) {
+                snprintf(text, sizeof(text), "SE V%X, V%X", x, y);
+            } else if (n == 0x2) {
+                snprintf(text, sizeof(text), "SAVE V%X-V%X", x, y);
+            } else if (n == 0x3) {
+                snprintf(text, sizeof(text), "LOAD V%X-V%X", x, y);
+            } else {
+                snprintf(text, sizeof(text), "DW #%04X", opcode);
+            }
+            break;
+        case 0x6: snprintf(text, sizeof(text), "LD V%X, #%02X", x, nn); break;
+        case 0x7: snprintf(text, sizeof(text), "ADD V%X, #%02X", x, nn); break;
+        case 0x8:
+            switch (n)
+            {
+                case 0x0: snprintf(text, sizeof(text), "LD V%X, V%X", x, y); break;
+                case 0x1: snprintf(text, sizeof(text), "OR V%X, V%X", x, y); break;
+                case 0x2: snprintf(text, sizeof(text), "AND V%X, V%X", x, y); break;
+                case 0x3: snprintf(text, sizeof(text), "XOR V%X, V%X", x, y); break;
+                case 0x4: snprintf(text, sizeof(text), "ADD V%X, V%X", x, y); break;
+                case 0x5: snprintf(text, sizeof(text), "SUB V%X, V%X", x, y); break;
+                case 0x6: snprintf(text, sizeof(text), "SHR V%X, V%X", x, y); break;
+                case 0x7: snprintf(text, sizeof(text), "SUBN V%X, V%X", x, y); break;
+                case 0xE: snprintf(text, sizeof(text), "SHL V%X, V%X", x, y); break;
+                default:  snprintf(text, sizeof(text), "DW #%04X", opcode); break;
+            }
+            break;
+        case 0x9: snprintf(text, sizeof(text), "SNE V%X, V%X", x, y); break;
+        case 0xA: snprintf(text, sizeof(text), "LD I, #%03X", nnn); break;
+        case 0xB: snprintf(text, sizeof(text), "JP V0, #%03X", nnn); break;
+        case 0xC: snprintf(text, sizeof(text), "RND V%X, #%02X", x, nn); break;
+        case 0xD: snprintf(text, sizeof(text), "DRW V%X, V%X, %X", x, y, n); break;
+        case 0xE:
+            if (nn == 0x9E) {
+                snprintf(text, sizeof(text), "SKP V%X", x);
+            } else if (nn == 0xA1) {
+                snprintf(text, sizeof(text), "SKNP V%X", x);
+            } else {
+                snprintf(text, sizeof(text), "DW #%04X", opcode);
+            }
+            break;
+        case 0xF:
+            if (opcode == 0xF000 && xochip) {
+                length = 4;
+                snprintf(text, sizeof(text), "LD I, #%04X", next);
+                break;
+            }
+            switch (nn)
+            {
+                case 0x01: snprintf(text, sizeof(text), "PLANE %X", x); break;
+                case 0x02: snprintf(text, sizeof(text), "AUDIO"); break;
+                case 0x07: snprintf(text, sizeof(text), "LD V%X, DT", x); break;
+                case 0x0A: snprintf(text, sizeof(text), "LD V%X, K", x); break;
+                case 0x15: snprintf(text, sizeof(text), "LD DT, V%X", x); break;
+                case 0x18: snprintf(text, sizeof(text), "LD ST, V%X", x); break;
+                case 0x1E: snprintf(text, sizeof(text), "ADD I, V%X", x); break;
+                case 0x29: snprintf(text, sizeof(text), "LD F, V%X", x); break;
+                case 0x30: snprintf(text, sizeof(text), "LD HF, V%X", x); break;
+                case 0x33: snprintf(text, sizeof(text), "LD B, V%X", x); break;
+                case 0x3A: snprintf(text, sizeof(text), "PITCH V%X", x); break;
+                case 0x55: snprintf(text, sizeof(text), "LD [I], V%X", x); break;
+                case 0x65: snprintf(text, sizeof(text), "LD V%X, [I]", x); break;
+                case 0x75: snprintf(text, sizeof(text), "LD R, V%X", x); break;
+                case 0x85: snprintf(text, sizeof(text), "LD V%X, R", x); break;
+                default:   snprintf(text, sizeof(text), "DW #%04X", opcode); break;
+            }
+            break;
+    }
+    return text;
+}
@@ -0,0 +1,176 @@
+#include <filewatcher.h>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+namespace fs = std::filesystem;
+
+
+FileWatcher::FileWatcher() : stopping(false), pendingChange(false) {
+#ifdef _WIN32
+    stopEvent = NULL;
+#else
+    stopPipe[0] = -1;
+    stopPipe[1] = -1;
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+    stop();
+}
+
+bool FileWatcher::watch(const std::string& fileName) {
+
+    stop();
+    path = fileName;
+    stopping = false;
+    pendingChange = false;
+
+#ifdef _WIN32
+    stopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    if (stopEvent == NULL) {
+        return false;
+    }
+#else
+    if (pipe(stopPipe) != 0) {
+        return false;
+    }
+#endif
+
+    worker = std::thread(&FileWatcher::run, this);
+    return true;
+}
+
+void FileWatcher::stop() {
+
+    if (!worker.joinable()) {
+        return;
+    }
+
+    //Wake the thread up
+    stopping = true;
+#ifdef _WIN32
+    SetEvent((HANDLE)stopEvent);
+#else
+    char wake = 1;
+    (void)!write(stopPipe[1], &wake, 1);
+#endif
+    worker.join();
+
+#ifdef _WIN32
+    CloseHandle((HANDLE)stopEvent);
+    stopEvent = NULL;
+#else
+    close(stopPipe[0]);
+    close(stopPipe[1]);
+    stopPipe[0] = -1;
+    stopPipe[1] = -1;
+#endif
+}
+
+bool FileWatcher::watching() {
+    return worker.joinable();
+}
+
+//True once per (debounced) change of the file
+bool FileWatcher::changed() {
+    return pendingChange.exchange(false);
+}
+
+void FileWatcher::run() {
+
+    fs::path file(path);
+    std::string dir = file.parent_path().string();
+    if (dir.empty()) {
+        dir = ".";
+    }
+
+    //A change is only reported once the file has been quiet for DEBOUNCE_MS
+    bool dirty = false;
+
+#ifdef _WIN32
+    HANDLE change = FindFirstChangeNotificationA(dir.c_str(), FALSE,
+        FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE);
+    if (change == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    //Notifications are per folder, compare the file's write time to filter
+    std::error_code ec;
+    fs::file_time_type lastWrite = fs::last_write_time(file, ec);
+
+    while (!stopping)
+    {
+        HANDLE handles[2] = { change, (HANDLE)stopEvent };
+        DWORD ready = WaitForMultipleObjects(2, handles, FALSE, dirty ? DEBOUNCE_MS : INFINITE);
+
+        if (ready == WAIT_OBJECT_0) {
+            fs::file_time_type now = fs::last_write_time(file, ec);
+            if (!ec && now != lastWrite) {
+                lastWrite = now;
+                dirty = true;
+            }
+            FindNextChangeNotification(change);
+        } else if (ready == WAIT_TIMEOUT) {
+            dirty = false;
+            pendingChange = true;
+        } else {
+            break;
+        }
+    }
+
+    FindCloseChangeNotification(change);
+#else
+    std::string name = file.filename().string();
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    if (inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(fd);
+        return;
+    }
+
+    alignas(struct inotify_event) char buffer[4096];
+
+    while (!stopping)
+    {
+        struct pollfd fds[2] = { { fd, POLLIN, 0 }, { stopPipe[0], POLLIN, 0 } };
+        int ready = poll(fds, 2, dirty ? DEBOUNCE_MS : -1);
+
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (ready == 0) {
+            dirty = false;
+            pendingChange = true;
+            continue;
+        }
+        if (fds[1].revents != 0) {
+            break;
+        }
+
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        for (char* p = buffer; length > 0 && p < buffer + length; )
+        {
+            struct inotify_event* event = (struct inotify_event*)p;
+            if (event->len > 0 && name == event->name) {
+                dirty = true;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    close(fd);
+#endif
+}
@@ -0,0 +1,650 @@
+#include <gdbstub.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define closeSocket closesocket
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#define closeSocket close
+#endif
+
+
+static const char* targetXml =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+    "<target version=\"1.0\">"
+    "<feature name=\"org.chip8.core\">"
+    "<reg name=\"v0\" bitsize=\"8\" type=\"uint8\" regnum=\"0\"/>"
+    "<reg name=\"v1\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"v2\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"v3\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"v4\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"v5\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"v6\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"v7\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"v8\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"v9\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"va\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"vb\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"vc\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"vd\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"ve\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"vf\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"i\" bitsize=\"16\" type=\"data_ptr\"/>"
+    "<reg name=\"pc\" bitsize=\"16\" type=\"code_ptr\"/>"
+    "<reg name=\"sp\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"dt\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"st\" bitsize=\"8\" type=\"uint8\"/>"
+    "</feature>"
+    "</target>";
+
+//Register numbers (order of the 'g' packet)
+enum {
+    REG_V0 = 0,
+    REG_I = 16,
+    REG_PC,
+    REG_SP,
+    REG_DT,
+    REG_ST,
+    REG_COUNT
+};
+
+
+static void appendHex(std::string& out, unsigned char value) {
+    static const char digits[] = "0123456789abcdef";
+    out += digits[value >> 4];
+    out += digits[value & 0xF];
+}
+
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+//Hex string to bytes, false on odd length or bad digits
+static bool decodeHex(const std::string& hex, std::string& bytes) {
+    if (hex.size() % 2 != 0) {
+        return false;
+    }
+    bytes.clear();
+    for (size_t i = 0; i < hex.size(); i += 2)
+    {
+        int high = hexDigit(hex[i]);
+        int low = hexDigit(hex[i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        bytes += (char)(high << 4 | low);
+    }
+    return true;
+}
+
+
+GdbStub::GdbStub() : stopping(false), clientConnected(false), attached(false), interrupted(false) {
+    listenSocket = -1;
+    clientSocket = -1;
+    waitingForStop = false;
+}
+
+GdbStub::~GdbStub() {
+    stop();
+}
+
+bool GdbStub::listenTcp(unsigned short port, std::string& error) {
+
+    stop();
+
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        error = "WSAStartup failed";
+        return false;
+    }
+#endif
+
+    long long s = (long long)socket(AF_INET, SOCK_STREAM, 0);
+    if (s < 0) {
+        error = "socket() failed";
+        return false;
+    }
+
+    int yes = 1;
+    setsockopt((int)s, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof(yes));
+
+    //Local connections only
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (bind((int)s, (sockaddr*)&address, sizeof(address)) != 0 || listen((int)s, 1) != 0) {
+        closeSocket((int)s);
+        error = "Can't listen on port " + std::to_string(port);
+        return false;
+    }
+
+    listenSocket = s;
+    name = "localhost:" + std::to_string(port);
+    stopping = false;
+    worker = std::thread(&GdbStub::run, this);
+    return true;
+}
+
+bool GdbStub::listenUnix(const std::string& path, std::string& error) {
+
+    stop();
+
+#ifdef _WIN32
+    (void)path;
+    error = "Unix sockets are not supported on Windows";
+    return false;
+#else
+    long long s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s < 0) {
+        error = "socket() failed";
+        return false;
+    }
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        close((int)s);
+        error = "Socket path is too long";
+        return false;
+    }
+    strcpy(address.sun_path, path.c_str());
+    unlink(path.c_str());
+    if (bind((int)s, (sockaddr*)&address, sizeof(address)) != 0 || listen((int)s, 1) != 0) {
+        close((int)s);
+        error = "Can't listen on " + path;
+        return false;
+    }
+
+    listenSocket = s;
+    name = path;
+    unixPath = path;
+    stopping = false;
+    worker = std::thread(&GdbStub::run, this);
+    return true;
+#endif
+}
+
+void GdbStub::stop() {
+
+    if (worker.joinable()) {
+        stopping = true;
+        worker.join();
+    }
+    if (listenSocket >= 0) {
+        closeSocket((int)listenSocket);
+        listenSocket = -1;
+    }
+#ifndef _WIN32
+    if (!unixPath.empty()) {
+        unlink(unixPath.c_str());
+        unixPath.clear();
+    }
+#endif
+    name.clear();
+}
+
+bool GdbStub::listening() {
+    return listenSocket >= 0;
+}
+
+bool GdbStub::connected() {
+    return clientConnected;
+}
+
+std::string GdbStub::endpoint() {
+    return name;
+}
+
+void GdbStub::reply(const std::string& payload) {
+    std::lock_guard<std::mutex> guard(lock);
+    replies.push_back(payload);
+}
+
+//Network thread: accept, split packets, send replies
+void GdbStub::run() {
+
+    std::string input;
+
+    while (!stopping)
+    {
+        //Wait for a debugger
+        if (clientSocket < 0) {
+            fd_set readable;
+            FD_ZERO(&readable);
+            FD_SET((int)listenSocket, &readable);
+            timeval timeout = { 0, 100000 };
+            if (select((int)listenSocket + 1, &readable, NULL, NULL, &timeout) <= 0) {
+                continue;
+            }
+            long long s = (long long)accept((int)listenSocket, NULL, NULL);
+            if (s < 0) {
+                continue;
+            }
+            int yes = 1;
+            setsockopt((int)s, IPPROTO_TCP, TCP_NODELAY, (const char*)&yes, sizeof(yes));
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                commands.clear();
+                replies.clear();
+            }
+            input.clear();
+            clientSocket = s;
+            clientConnected = true;
+            attached = true;
+            continue;
+        }
+
+        //Replies produced by the emulation thread
+        std::deque<std::string> outgoing;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            outgoing.swap(replies);
+        }
+        for (const std::string& payload : outgoing)
+        {
+            //Escape the framing characters
+            std::string body;
+            unsigned char sum = 0;
+            for (char c : payload)
+            {
+                if (c == '$' || c == '#' || c == '}' || c == '*') {
+                    body += '}';
+                    c ^= 0x20;
+                }
+                body += c;
+            }
+            for (char c : body)
+            {
+                sum += (unsigned char)c;
+            }
+            std::string packet = "$" + body + "#";
+            appendHex(packet, sum);
+            send((int)clientSocket, packet.data(), (int)packet.size(), 0);
+        }
+
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET((int)clientSocket, &readable);
+        timeval timeout = { 0, 10000 };
+        if (select((int)clientSocket + 1, &readable, NULL, NULL, &timeout) <= 0) {
+            continue;
+        }
+
+        char buffer[4096];
+        int received = (int)recv((int)clientSocket, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            //Disconnected: let the program run again
+            closeSocket((int)clientSocket);
+            clientSocket = -1;
+            clientConnected = false;
+            std::lock_guard<std::mutex> guard(lock);
+            commands.push_back("D");
+            continue;
+        }
+        input.append(buffer, received);
+
+        //Packets: $payload#cs (acks and stray bytes are skipped)
+        size_t at = 0;
+        while (at < input.size())
+        {
+            if (input[at] == 0x03) {
+                interrupted = true;
+                at++;
+                continue;
+            }
+            if (input[at] != '$') {
+                at++;
+                continue;
+            }
+            size_t end = input.find('#', at);
+            if (end == std::string::npos || end + 2 >= input.size()) {
+                break;
+            }
+
+            std::string payload = input.substr(at + 1, end - at - 1);
+            unsigned char sum = 0;
+            for (char c : payload)
+            {
+                sum += (unsigned char)c;
+            }
+            int expected = hexDigit(input[end + 1]) << 4 | hexDigit(input[end + 2]);
+            at = end + 3;
+
+            if (expected != sum) {
+                send((int)clientSocket, "-", 1, 0);
+                continue;
+            }
+            send((int)clientSocket, "+", 1, 0);
+            std::lock_guard<std::mutex> guard(lock);
+            commands.push_back(payload);
+        }
+        input.erase(0, at);
+    }
+
+    if (clientSocket >= 0) {
+        closeSocket((int)clientSocket);
+        clientSocket = -1;
+    }
+    clientConnected = false;
+}
+
+//Emulation thread: run the queued packets against the core
+void GdbStub::service(Chip8& chip8) {
+
+    //A debugger expects the target to be stopped when it attaches
+    if (attached.exchange(false)) {
+        chip8.debugger.pause(Debugger::StopReason::User, chip8.pc);
+        waitingForStop = false;
+    }
+
+    if (interrupted.exchange(false) && !chip8.debugger.paused) {
+        chip8.debugger.pause(Debugger::StopReason::User, chip8.pc);
+    }
+
+    std::deque<std::string> pending;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        pending.swap(commands);
+    }
+    for (const std::string& packet : pending)
+    {
+        std::string response;
+        if (execute(chip8, packet, response)) {
+            reply(response);
+        }
+    }
+
+    //Continue finished (breakpoint, watchpoint, Ctrl-C or the UI paused it)
+    if (waitingForStop && chip8.debugger.paused) {
+        waitingForStop = false;
+        reply(stopReply(chip8));
+    }
+}
+
+std::string GdbStub::stopReply(Chip8& chip8) {
+    char text[32];
+    switch (chip8.debugger.reason)
+    {
+        case Debugger::StopReason::WatchWrite:
+            snprintf(text, sizeof(text), "T05watch:%x;", chip8.debugger.stopAddress);
+            return text;
+        case Debugger::StopReason::WatchRead:
+            snprintf(text, sizeof(text), "T05rwatch:%x;", chip8.debugger.stopAddress);
+            return text;
+        case Debugger::StopReason::User:
+            return "S02";
+        default:
+            return "S05";
+    }
+}
+
+std::string GdbStub::readRegisters(Chip8& chip8) {
+    std::string out;
+    for (int i = 0; i < 16; i++)
+    {
+        appendHex(out, chip8.v[i]);
+    }
+    //16 bit registers are little endian
+    appendHex(out, (unsigned char)chip8.index);
+    appendHex(out, (unsigned char)(chip8.index >> 8));
+    appendHex(out, (unsigned char)chip8.pc);
+    appendHex(out, (unsigned char)(chip8.pc >> 8));
+    appendHex(out, chip8.sp);
+    appendHex(out, chip8.delay_timer);
+    appendHex(out, chip8.sound_timer);
+    return out;
+}
+
+bool GdbStub::writeRegister(Chip8& chip8, unsigned int number, const std::string& hex) {
+
+    std::string bytes;
+    if (!decodeHex(hex, bytes) || bytes.empty()) {
+        return false;
+    }
+    unsigned short value = (unsigned char)bytes[0];
+    if (bytes.size() > 1) {
+        value |= (unsigned short)((unsigned char)bytes[1] << 8);
+    }
+
+    if (number < REG_I) {
+        chip8.v[number] = (unsigned char)value;
+    } else if (number == REG_I) {
+        chip8.index = value;
+    } else if (number == REG_PC) {
+        chip8.pc = value;
+    } else if (number == REG_SP) {
+        chip8.sp = (unsigned char)value;
+    } else if (number == REG_DT) {
+        chip8.delay_timer = (unsigned char)value;
+    } else if (number == REG_ST) {
+        chip8.sound_timer = (unsigned char)value;
+    } else {
+        return false;
+    }
+
+    //Recorded history no longer matches the registers
+    chip8.journal.clear();
+    return true;
+}
+
+//Returns false when the reply is deferred (continue) or there is none (kill)
+bool GdbStub::execute(Chip8& chip8, const std::string& packet, std::string& response) {
+
+    response.clear();
+    if (packet.empty()) {
+        return true;
+    }
+
+    char command = packet[0];
+    std::string args = packet.substr(1);
+
+    switch (command)
+    {
+        case '?':
+            response = stopReply(chip8);
+            return true;
+
+        case 'g':
+            response = readRegisters(chip8);
+            return true;
+
+        case 'G': {
+            const unsigned int widths[REG_COUNT] = { 1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, 2, 2, 1, 1, 1 };
+            size_t at = 0;
+            for (unsigned int r = 0; r < REG_COUNT && at < args.size(); r++)
+            {
+                if (!writeRegister(chip8, r, args.substr(at, widths[r] * 2))) {
+                    response = "E01";
+                    return true;
+                }
+                at += widths[r] * 2;
+            }
+            response = "OK";
+            return true;
+        }
+
+        case 'p': {
+            unsigned int number = (unsigned int)strtoul(args.c_str(), nullptr, 16);
+            std::string all = readRegisters(chip8);
+            if (number < REG_I) {
+                response = all.substr(number * 2, 2);
+            } else if (number < REG_COUNT) {
+                //I and PC take 2 bytes
+                size_t offset = number <= REG_PC ? 32 + (number - REG_I) * 4 : 40 + (number - REG_SP) * 2;
+                response = all.substr(offset, number <= REG_PC ? 4 : 2);
+            } else {
+                response = "E01";
+            }
+            return true;
+        }
+
+        case 'P': {
+            size_t equals = args.find('=');
+            if (equals == std::string::npos) {
+                response = "E01";
+                return true;
+            }
+            unsigned int number = (unsigned int)strtoul(args.substr(0, equals).c_str(), nullptr, 16);
+            response = writeRegister(chip8, number, args.substr(equals + 1)) ? "OK" : "E01";
+            return true;
+        }
+
+        case 'm': {
+            unsigned int address = 0;
+            unsigned int length = 0;
+            if (sscanf(args.c_str(), "%x,%x", &address, &length) != 2) {
+                response = "E01";
+                return true;
+            }
+            length = length > 0x800 ? 0x800 : length;
+            for (unsigned int i = 0; i < length; i++)
+            {
+                appendHex(response, chip8.peek(address + i));
+            }
+            return true;
+        }
+
+        case 'M': {
+            unsigned int address = 0;
+            unsigned int length = 0;
+            size_t colon = args.find(':');
+            std::string bytes;
+            if (sscanf(args.c_str(), "%x,%x", &address, &length) != 2 || colon == std::string::npos ||
+                    !decodeHex(args.substr(colon + 1), bytes) || bytes.size() != length) {
+                response = "E01";
+                return true;
+            }
+            for (unsigned int i = 0; i < length; i++)
+            {
+                chip8.poke(address + i, (unsigned char)bytes[i]);
+            }
+            response = "OK";
+            return true;
+        }
+
+        case 'Z':
+        case 'z': {
+            unsigned int type = 0;
+            unsigned int address = 0;
+            unsigned int kind = 0;
+            if (sscanf(args.c_str(), "%x,%x,%x", &type, &address, &kind) != 3 || type > 4) {
+                response = "";
+                return true;
+            }
+            address &= 0xFFFF;
+
+            //Software and hardware breakpoints are the same thing here
+            if (type <= 1) {
+                if (command == 'Z') {
+                    std::string error;
+                    chip8.debugger.addBreakpoint((unsigned short)address, "", error);
+                } else {
+                    chip8.debugger.removeBreakpoint((unsigned short)address);
+                }
+                response = "OK";
+                return true;
+            }
+
+            //Watchpoints: 2 write, 3 read, 4 access
+            unsigned char mode = type == 2 ? Debugger::WATCH_WRITE : type == 3 ? Debugger::WATCH_READ :
+                (Debugger::WATCH_READ | Debugger::WATCH_WRITE);
+            if (command == 'Z') {
+                chip8.debugger.addWatchpoint((unsigned short)address, (unsigned short)kind, mode);
+            } else {
+                for (size_t i = 0; i < chip8.debugger.watchpoints.size(); i++)
+                {
+                    const Debugger::Watchpoint& watchpoint = chip8.debugger.watchpoints[i];
+                    if (watchpoint.address == address && watchpoint.mode == mode) {
+                        chip8.debugger.removeWatchpoint(i);
+                        break;
+                    }
+                }
+            }
+            response = "OK";
+            return true;
+        }
+
+        case 's':
+            if (!args.empty()) {
+                chip8.pc = (unsigned short)strtoul(args.c_str(), nullptr, 16);
+            }
+            if (chip8.step()) {
+                chip8.updateTimers();
+            }
+            chip8.latchWrites();
+            response = stopReply(chip8);
+            return true;
+
+        case 'c':
+            if (!args.empty()) {
+                chip8.pc = (unsigned short)strtoul(args.c_str(), nullptr, 16);
+            }
+            chip8.debugger.resume(chip8.pc);
+            waitingForStop = true;
+            return false;
+
+        case 'D':
+            chip8.debugger.resume(chip8.pc);
+            waitingForStop = false;
+            response = "OK";
+            return true;
+
+        case 'k':
+            chip8.debugger.resume(chip8.pc);
+            waitingForStop = false;
+            return false;
+
+        case 'H':
+            response = "OK";
+            return true;
+
+        case 'q':
+            if (packet.compare(0, 10, "qSupported") == 0) {
+                response = "PacketSize=1000;qXfer:features:read+";
+            } else if (packet == "qAttached") {
+                response = "1";
+            } else if (packet == "qC") {
+                response = "QC1";
+            } else if (packet == "qfThreadInfo") {
+                response = "m1";
+            } else if (packet == "qsThreadInfo") {
+                response = "l";
+            } else if (packet.compare(0, 8, "qSymbol:") == 0) {
+                response = "OK";
+            } else if (packet.compare(0, 31, "qXfer:features:read:target.xml:") == 0) {
+                unsigned int offset = 0;
+                unsigned int length = 0;
+                sscanf(packet.c_str() + 31, "%x,%x", &offset, &length);
+                std::string xml = targetXml;
+                if (offset >= xml.size()) {
+                    response = "l";
+                } else {
+                    std::string chunk = xml.substr(offset, length);
+                    response = (offset + chunk.size() >= xml.size() ? "l" : "m") + chunk;
+                }
+            }
+            return true;
+
+        default:
+            //Unsupported: empty reply
+            return true;
+    }
+}
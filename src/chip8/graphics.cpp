@@ -4,21 +4,44 @@
 #include <imgui_impl_sdlrenderer2.h>
 #include <SDL.h>
 #include <bits/algorithmfwd.h>
+#include <algorithm>
+
+static_assert(Upscaler::PLANES == DISPLAY_PLANES && Upscaler::ROWS == DISPLAY_ROWS && Upscaler::WORDS == DISPLAY_WORDS, "upscaler display layout");
+static_assert(PostProcess::MAX_WIDTH == Upscaler::STRIDE && PostProcess::MAX_HEIGHT == DISPLAY_ROWS * Upscaler::MAX_FACTOR, "post process frame size");
 
 
 Graphics::Graphics(){
     WIDTH = 640;
     HEIGHT = 320;
+    SCREENX = 1242;
+    SCREENY = 720;
+    window = NULL;
+    renderer = NULL;
+    texture = NULL;
+    gameTexture = NULL;
+    displayWidth = 64;
+    displayHeight = 32;
+    vsync = false;
+    textureScale = 1;
+    dirty = true;
+
+    //Plane 0 white, plane 1 light grey, both dark grey (XO-CHIP)
+    palette[0] = 0xFF000000;
+    palette[1] = 0xFFFFFFFF;
+    palette[2] = 0xFFAAAAAA;
+    palette[3] = 0xFF555555;
 };
 
 void Graphics::init() {
 
 
     SDL_Init(SDL_INIT_EVERYTHING);
-    window = SDL_CreateWindow("CHIP8 EMU", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1242, 720, SDL_WINDOW_SHOWN);
+    window = SDL_CreateWindow("CHIP8 EMU", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREENX, SCREENY, SDL_WINDOW_SHOWN);
     renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
     
-    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, WIDTH, HEIGHT);
+    //One texel per pixel at the largest resolution, scaled up by ImGui::Image
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, DISPLAY_WORDS * 64, DISPLAY_ROWS);
+    SDL_SetTextureScaleMode(texture, SDL_ScaleModeNearest);
 
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
@@ -44,47 +67,99 @@ void Graphics::fullscreen(bool fullscreen) {
     }
 }
 
-void Graphics::drawDisplay(unsigned char display[64][32]) {
+//Widen the window by a column for tool windows right of the default layout (0: none)
+void Graphics::extendScreen(int width) {
 
-    // Set the target texture
-    SDL_SetRenderTarget(renderer, texture);
+    if (window == NULL) {
+        return;
+    }
+    int current;
+    SDL_GetWindowSize(window, &current, NULL);
+    if (current != SCREENX + width) {
+        SDL_SetWindowSize(window, SCREENX + width, SCREENY);
+    }
+}
 
-    // Clear the texture (black background)
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderClear(renderer);
+//Upscale the display, expand it into colours and run it through the effects
+//into the streaming texture (top left width x height times textureScale).
+//Nothing is redrawn while the display, the settings and the phosphor are settled.
+void Graphics::drawDisplay(const unsigned long long display[DISPLAY_PLANES][DISPLAY_ROWS][DISPLAY_WORDS], int width, int height) {
 
-    // Render the game pixels onto the texture
-    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    displayWidth = width;
+    displayHeight = height;
 
-    for (int i = 0; i < 64; i++)
-    {
-        for (int j = 0; j < 32; j++)
-        {
-            if (display[i][j] == 1)
-            {
-                SDL_Rect rect;
-                rect.x = i * 10;
-                rect.y = j * 10;
-                rect.w = 10;
-                rect.h = 10;
-                SDL_RenderFillRect(renderer, &rect);
-            }
+    bool changed = upscaler.process(display, width, height, palette, pool);
+
+    //The texture holds the largest resolution at the current scale
+    int wanted = scale();
+    if (renderer != NULL && (texture == NULL || wanted != textureScale)) {
+        if (texture != NULL) {
+            SDL_DestroyTexture(texture);
         }
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+            DISPLAY_WORDS * 64 * wanted, DISPLAY_ROWS * wanted);
+        SDL_SetTextureScaleMode(texture, SDL_ScaleModeNearest);
+        textureScale = wanted;
+        changed = true;
+    }
+    if (!changed && !dirty && !effects.fading()) {
+        return;
     }
 
-    // Reset the target texture
-    SDL_SetRenderTarget(renderer, NULL);
+    void* pixels;
+    int pitch;
+    if (texture == NULL || SDL_LockTexture(texture, NULL, &pixels, &pitch) != 0) {
+        return;
+    }
+    int factor = upscaler.factor();
+    effects.process(upscaler.frame(), Upscaler::STRIDE, width * factor, height * factor, textureScale / factor,
+        (Uint32*)pixels, pitch, pool);
+    SDL_UnlockTexture(texture);
+    dirty = false;
 }
 
-void Graphics::clear(unsigned char display[64][32]) {
-    //Clear display matrix
-    for (int i = 0; i < 64; i++)
-    {
-        for (int j = 0; j < 32; j++)
-        {
-            display[i][j] = 0;
-        }
+//Largest integer scale that fits the game window, a multiple of the upscaler's
+//factor (1 without upscaler and effects: ImGui stretches the texture)
+int Graphics::scale() {
+    int factor = upscaler.factor();
+    if (factor == 1 && !effects.enabled()) {
+        return 1;
     }
-    SDL_RenderClear(renderer);
+    return factor * std::max(1, std::min(WIDTH / (displayWidth * factor), HEIGHT / (displayHeight * factor)));
 }
 
+//Effect settings changed: redraw on the next drawDisplay()
+void Graphics::invalidate() {
+    dirty = true;
+}
+
+//Part of the texture holding the current resolution
+ImVec2 Graphics::displayUV() {
+    return ImVec2(displayWidth / (float)(DISPLAY_WORDS * 64), displayHeight / (float)DISPLAY_ROWS);
+}
+
+//On screen size of the display: the whole game window, or its integer scale
+//with effects on
+ImVec2 Graphics::displaySize() {
+    if (textureScale > 1) {
+        return ImVec2((float)(displayWidth * textureScale), (float)(displayHeight * textureScale));
+    }
+    return ImVec2((float)WIDTH, (float)HEIGHT);
+}
+
+//Ask the renderer to sync presents to the display (not every driver can)
+void Graphics::setVSync(bool on) {
+    vsync = on;
+    if (renderer != NULL) {
+        SDL_RenderSetVSync(renderer, on ? 1 : 0);
+    }
+}
+
+//Draw the UI built since ImGui::NewFrame() (the game texture is one of its
+//images) and show it: the only present of a frame
+void Graphics::present() {
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+    ImGui_ImplSDLRenderer2_RenderDrawData(ImGui::GetDrawData(), renderer);
+    SDL_RenderPresent(renderer);
+}
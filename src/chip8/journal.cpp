@@ -0,0 +1,147 @@
+#include <journal.h>
+#include <string.h>
+#include <stdlib.h>
+
+
+Journal::Journal() {
+    enabled = false;
+    ring = NULL;
+    capacity = DEFAULT_CAPACITY;
+    head = 0;
+    tail = 0;
+    used = 0;
+    count = 0;
+    recordLength = 0;
+    recordPC = 0;
+}
+
+Journal::~Journal() {
+    free(ring);
+}
+
+void Journal::clear() {
+    head = 0;
+    tail = 0;
+    used = 0;
+    count = 0;
+    recordLength = 0;
+}
+
+bool Journal::empty() {
+    return count == 0;
+}
+
+size_t Journal::bytes() {
+    return used;
+}
+
+size_t Journal::records() {
+    return count;
+}
+
+void Journal::begin(unsigned char type, unsigned short pc) {
+    //The arena is only allocated once debugging actually records something
+    if (ring == NULL) {
+        ring = (unsigned char*)malloc(capacity);
+    }
+    record[0] = type;
+    recordLength = 1;
+    recordPC = pc;
+}
+
+void Journal::put8(unsigned char value) {
+    if (recordLength < MAX_RECORD) {
+        record[recordLength++] = value;
+    }
+}
+
+void Journal::put16(unsigned short value) {
+    put8((unsigned char)(value >> 8));
+    put8((unsigned char)value);
+}
+
+void Journal::put64(unsigned long long value) {
+    for (int i = 56; i >= 0; i -= 8)
+    {
+        put8((unsigned char)(value >> i));
+    }
+}
+
+void Journal::commit(bool storePC) {
+
+    if (ring == NULL) {
+        return;
+    }
+
+    //Insert the PC after the type byte when it can't be derived
+    if (storePC && recordLength + 2 <= MAX_RECORD) {
+        memmove(record + 3, record + 1, recordLength - 1);
+        record[0] |= RECORD_HAS_PC;
+        record[1] = (unsigned char)(recordPC >> 8);
+        record[2] = (unsigned char)recordPC;
+        recordLength += 2;
+    }
+
+    size_t total = recordLength + 4;
+    while (used + total > capacity && count > 0)
+    {
+        dropOldest();
+    }
+
+    unsigned char length[2] = { (unsigned char)(recordLength >> 8), (unsigned char)recordLength };
+    write(length, 2);
+    write(record, recordLength);
+    write(length, 2);
+    count++;
+    recordLength = 0;
+}
+
+//PC passed to begin() (the instruction being recorded)
+unsigned short Journal::startPC() {
+    return recordPC;
+}
+
+bool Journal::pop(unsigned char* out, size_t& length) {
+
+    if (count == 0) {
+        return false;
+    }
+
+    //Trailing length tells where the newest record starts
+    size_t end = (head + capacity - 2) % capacity;
+    length = read16(end);
+    size_t start = (end + capacity - length) % capacity;
+    read(start, out, length);
+
+    head = (start + capacity - 2) % capacity;
+    used -= length + 4;
+    count--;
+    return true;
+}
+
+void Journal::dropOldest() {
+    size_t length = read16(tail);
+    tail = (tail + length + 4) % capacity;
+    used -= length + 4;
+    count--;
+}
+
+void Journal::write(const unsigned char* data, size_t length) {
+    size_t first = capacity - head < length ? capacity - head : length;
+    memcpy(ring + head, data, first);
+    memcpy(ring, data + first, length - first);
+    head = (head + length) % capacity;
+    used += length;
+}
+
+void Journal::read(size_t at, unsigned char* data, size_t length) {
+    size_t first = capacity - at < length ? capacity - at : length;
+    memcpy(data, ring + at, first);
+    memcpy(data + first, ring, length - first);
+}
+
+unsigned short Journal::read16(size_t at) {
+    unsigned char bytes[2];
+    read(at, bytes, 2);
+    return (unsigned short)(bytes[0] << 8 | bytes[1]);
+}
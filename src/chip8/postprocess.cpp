@@ -0,0 +1,215 @@
+#include <postprocess.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define POSTPROCESS_X86
+#include <immintrin.h>
+#endif
+
+
+//Phosphor: phosphor = max(frame, phosphor * decay / 256) per channel.
+//Returns true when some pixel is still above the frame.
+typedef bool (*PhosphorKernel)(Uint32* phosphor, const Uint32* frame, int count, int decay);
+
+//Scanline: in at half brightness (opaque)
+typedef void (*ScanlineKernel)(Uint32* out, const Uint32* in, int count);
+
+static bool phosphorScalar(Uint32* phosphor, const Uint32* frame, int count, int decay) {
+    bool fading = false;
+    for (int i = 0; i < count; i++)
+    {
+        Uint32 result = 0;
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            unsigned int kept = ((phosphor[i] >> shift) & 0xFF) * decay >> 8;
+            unsigned int lit = (frame[i] >> shift) & 0xFF;
+            result |= (kept > lit ? kept : lit) << shift;
+        }
+        fading |= result != frame[i];
+        phosphor[i] = result;
+    }
+    return fading;
+}
+
+static void scanlineScalar(Uint32* out, const Uint32* in, int count) {
+    for (int i = 0; i < count; i++)
+    {
+        out[i] = ((in[i] >> 1) & 0x007F7F7F) | 0xFF000000;
+    }
+}
+
+#ifdef POSTPROCESS_X86
+__attribute__((target("sse2")))
+static bool phosphorSSE2(Uint32* phosphor, const Uint32* frame, int count, int decay) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i factor = _mm_set1_epi16((short)decay);
+    __m128i differ = zero;
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i p = _mm_loadu_si128((const __m128i*)(phosphor + i));
+        __m128i f = _mm_loadu_si128((const __m128i*)(frame + i));
+        __m128i low = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(p, zero), factor), 8);
+        __m128i high = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(p, zero), factor), 8);
+        __m128i result = _mm_max_epu8(_mm_packus_epi16(low, high), f);
+        differ = _mm_or_si128(differ, _mm_xor_si128(result, f));
+        _mm_storeu_si128((__m128i*)(phosphor + i), result);
+    }
+    bool fading = _mm_movemask_epi8(_mm_cmpeq_epi8(differ, zero)) != 0xFFFF;
+    return phosphorScalar(phosphor + i, frame + i, count - i, decay) || fading;
+}
+
+__attribute__((target("sse2")))
+static void scanlineSSE2(Uint32* out, const Uint32* in, int count) {
+    const __m128i mask = _mm_set1_epi32(0x007F7F7F);
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(in + i));
+        pixels = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(pixels, 1), mask), alpha);
+        _mm_storeu_si128((__m128i*)(out + i), pixels);
+    }
+    scanlineScalar(out + i, in + i, count - i);
+}
+
+//Same as SSE2 on 8 pixels (unpack and pack work per 128-bit lane, so the order is kept)
+__attribute__((target("avx2")))
+static bool phosphorAVX2(Uint32* phosphor, const Uint32* frame, int count, int decay) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i factor = _mm256_set1_epi16((short)decay);
+    __m256i differ = zero;
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i p = _mm256_loadu_si256((const __m256i*)(phosphor + i));
+        __m256i f = _mm256_loadu_si256((const __m256i*)(frame + i));
+        __m256i low = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(p, zero), factor), 8);
+        __m256i high = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(p, zero), factor), 8);
+        __m256i result = _mm256_max_epu8(_mm256_packus_epi16(low, high), f);
+        differ = _mm256_or_si256(differ, _mm256_xor_si256(result, f));
+        _mm256_storeu_si256((__m256i*)(phosphor + i), result);
+    }
+    bool fading = _mm256_movemask_epi8(_mm256_cmpeq_epi8(differ, zero)) != -1;
+    return phosphorScalar(phosphor + i, frame + i, count - i, decay) || fading;
+}
+
+__attribute__((target("avx2")))
+static void scanlineAVX2(Uint32* out, const Uint32* in, int count) {
+    const __m256i mask = _mm256_set1_epi32(0x007F7F7F);
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i pixels = _mm256_loadu_si256((const __m256i*)(in + i));
+        pixels = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(pixels, 1), mask), alpha);
+        _mm256_storeu_si256((__m256i*)(out + i), pixels);
+    }
+    scanlineScalar(out + i, in + i, count - i);
+}
+#endif
+
+struct Kernels {
+    const char* name;
+    PhosphorKernel phosphor;
+    ScanlineKernel scanline;
+};
+
+//Widest instruction set of this CPU (checked once)
+static const Kernels& activeKernels() {
+    static const Kernels kernels = []() {
+#ifdef POSTPROCESS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return Kernels{ "AVX2", phosphorAVX2, scanlineAVX2 };
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return Kernels{ "SSE2", phosphorSSE2, scanlineSSE2 };
+        }
+#endif
+        return Kernels{ "scalar", phosphorScalar, scanlineScalar };
+    }();
+    return kernels;
+}
+
+
+PostProcess::PostProcess() {
+    decay = 0;
+    scanlines = false;
+    phosphor.assign(MAX_WIDTH * MAX_HEIGHT, 0xFF000000);
+    phosphorFading = false;
+    phosphorWidth = 0;
+    phosphorHeight = 0;
+}
+
+//Anything to do besides copying the frame
+bool PostProcess::enabled() {
+    return decay > 0 || scanlines;
+}
+
+//The phosphor still differs from the last frame: process() needs to run on
+//the next frames even if the display doesn't change
+bool PostProcess::fading() {
+    return phosphorFading;
+}
+
+//Instruction set of the kernels in use
+const char* PostProcess::kernels() {
+    return activeKernels().name;
+}
+
+//One emulated frame: frame (width x height, stride pixels per row) through the
+//phosphor, scaled by scale into out (pitch in bytes)
+void PostProcess::process(const Uint32* frame, int stride, int width, int height, int scale, Uint32* out, int pitch, ThreadPool& pool) {
+
+    const Kernels& kernels = activeKernels();
+    int factor = decay < 256 ? decay : 255;
+
+    //A new frame size starts from the frame (nothing left over to fade)
+    if (width != phosphorWidth || height != phosphorHeight) {
+        for (int y = 0; y < height; y++)
+        {
+            memcpy(&phosphor[y * MAX_WIDTH], frame + y * stride, width * sizeof(Uint32));
+        }
+        phosphorWidth = width;
+        phosphorHeight = height;
+    }
+
+    phosphorFading = false;
+    pool.bands(height, [&](int first, int last) {
+        bool fading = false;
+        for (int y = first; y < last; y++)
+        {
+            Uint32* in = &phosphor[y * MAX_WIDTH];
+            fading |= kernels.phosphor(in, frame + y * stride, width, factor);
+
+            Uint32* row = (Uint32*)((unsigned char*)out + y * scale * pitch);
+            if (scale == 1) {
+                memcpy(row, in, width * sizeof(Uint32));
+                continue;
+            }
+
+            //First row of the scaled pixel row, then copies of it (the last one darker)
+            for (int x = 0; x < width; x++)
+            {
+                Uint32* pixel = row + x * scale;
+                for (int s = 0; s < scale; s++)
+                {
+                    pixel[s] = in[x];
+                }
+            }
+            for (int r = 1; r < scale; r++)
+            {
+                Uint32* line = (Uint32*)((unsigned char*)row + r * pitch);
+                if (scanlines && r == scale - 1) {
+                    kernels.scanline(line, row, width * scale);
+                } else {
+                    memcpy(line, row, width * scale * sizeof(Uint32));
+                }
+            }
+        }
+        if (fading) {
+            phosphorFading = true;
+        }
+    });
+}
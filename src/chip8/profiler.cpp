@@ -0,0 +1,117 @@
+#include <profiler.h>
+#include <string.h>
+#include <algorithm>
+
+
+static const char* classNames[Profiler::OP_CLASSES] = {
+    "CLS", "RET", "SYS", "JP", "CALL", "SE Vx, byte", "SNE Vx, byte", "SE Vx, Vy",
+    "LD Vx, byte", "ADD Vx, byte", "ALU 8XYN", "SNE Vx, Vy", "LD I, addr", "JP V0, addr", "RND", "DRW",
+    "SKP/SKNP", "LD Vx, DT", "LD Vx, K", "LD DT, Vx", "LD ST, Vx", "ADD I, Vx", "LD F, Vx", "LD B, Vx",
+    "LD [I], Vx", "LD Vx, [I]", "AUDIO/PITCH", "Other"
+};
+
+
+Profiler::Profiler() {
+    enabled = false;
+    executions = NULL;
+    reads = NULL;
+    writes = NULL;
+    memset(classCount, 0, sizeof(classCount));
+    total = 0;
+}
+
+Profiler::~Profiler() {
+    delete[] executions;
+    delete[] reads;
+    delete[] writes;
+}
+
+//Counters are allocated the first time the profiler is switched on
+void Profiler::enable(bool on) {
+    if (on && executions == NULL) {
+        executions = new unsigned int[ADDRESSES];
+        reads = new unsigned int[ADDRESSES];
+        writes = new unsigned int[ADDRESSES];
+        reset();
+    }
+    enabled = on;
+}
+
+void Profiler::reset() {
+    if (executions != NULL) {
+        memset(executions, 0, ADDRESSES * sizeof(unsigned int));
+        memset(reads, 0, ADDRESSES * sizeof(unsigned int));
+        memset(writes, 0, ADDRESSES * sizeof(unsigned int));
+    }
+    memset(classCount, 0, sizeof(classCount));
+    total = 0;
+}
+
+//The n addresses with the highest counts (partial sort, no full ordering)
+void Profiler::hottest(const unsigned int* counts, size_t n, std::vector<HotAddress>& out) {
+
+    out.clear();
+    if (counts == NULL) {
+        return;
+    }
+
+    for (unsigned int address = 0; address < ADDRESSES; address++)
+    {
+        if (counts[address] != 0) {
+            out.push_back({ (unsigned short)address, counts[address] });
+        }
+    }
+
+    auto hotter = [](const HotAddress& a, const HotAddress& b) { return a.count > b.count; };
+    if (out.size() > n) {
+        std::partial_sort(out.begin(), out.begin() + n, out.end(), hotter);
+        out.resize(n);
+    } else {
+        std::sort(out.begin(), out.end(), hotter);
+    }
+}
+
+int Profiler::opcodeClass(unsigned short opcode) {
+
+    switch (opcode >> 12)
+    {
+        case 0x0:
+            if (opcode == 0x00E0) return OP_CLS;
+            if (opcode == 0x00EE) return OP_RET;
+            return OP_SYS;
+        case 0x1: return OP_JP;
+        case 0x2: return OP_CALL;
+        case 0x3: return OP_SE_BYTE;
+        case 0x4: return OP_SNE_BYTE;
+        case 0x5: return OP_SE_REG;
+        case 0x6: return OP_LD_BYTE;
+        case 0x7: return OP_ADD_BYTE;
+        case 0x8: return OP_ALU;
+        case 0x9: return OP_SNE_REG;
+        case 0xA: return OP_LD_I;
+        case 0xB: return OP_JP_V0;
+        case 0xC: return OP_RND;
+        case 0xD: return OP_DRW;
+        case 0xE: return OP_SKP;
+    }
+
+    switch (opcode & 0x00FF)
+    {
+        case 0x02: return OP_AUDIO;
+        case 0x07: return OP_LD_DT_READ;
+        case 0x0A: return OP_LD_KEY;
+        case 0x15: return OP_LD_DT;
+        case 0x18: return OP_LD_ST;
+        case 0x1E: return OP_ADD_I;
+        case 0x29: return OP_LD_FONT;
+        case 0x33: return OP_BCD;
+        case 0x3A: return OP_AUDIO;
+        case 0x55: return OP_STORE;
+        case 0x65: return OP_LOAD;
+    }
+    return OP_OTHER;
+}
+
+const char* Profiler::className(int opClass) {
+    return opClass >= 0 && opClass < OP_CLASSES ? classNames[opClass] : "?";
+}
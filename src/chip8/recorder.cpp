@@ -0,0 +1,241 @@
+#include <recorder.h>
+#include <string.h>
+#include <chrono>
+
+
+Recorder::Recorder() : running(false), head(0), tail(0), written(0), lost(0), size(0) {
+    file = NULL;
+    audioRead = 0;
+    started = false;
+    memset(&startState, 0, sizeof(startState));
+    memset(previous, 0, sizeof(previous));
+    previousHires = false;
+    memset(previousPalette, 0, sizeof(previousPalette));
+    lastKey = 0;
+}
+
+Recorder::~Recorder() {
+    close();
+}
+
+bool Recorder::open(const std::string& fileName, Audio& audio, std::string& error) {
+
+    close();
+
+    file = fopen(fileName.c_str(), "wb");
+    if (file == NULL) {
+        error = "Can't create " + fileName;
+        return false;
+    }
+
+    RecordHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RECORD_MAGIC, 4);
+    header.version = RECORD_VERSION;
+    header.fps = 60;
+    header.sampleRate = Audio::SAMPLE_RATE;
+    header.frameSamples = FRAME_SAMPLES;
+    fwrite(&header, sizeof(header), 1, file);
+
+    path = fileName;
+    slots.resize(SLOTS);
+    raw.reserve(PLANES * ROWS * WORDS * 8);
+    coded.reserve(PLANES * ROWS * WORDS * 8 * 2);
+    head.store(0);
+    tail.store(0);
+    written.store(0);
+    lost.store(0);
+    size.store(sizeof(header));
+
+    //The audio state already set plays from the first frame on
+    audioRead = audio.historyCount;
+    started = false;
+    startState = audio.current();
+
+    running.store(true);
+    encoder = std::thread(&Recorder::run, this);
+    return true;
+}
+
+//Write what is left in the ring and close the file
+void Recorder::close() {
+
+    if (!recording()) {
+        return;
+    }
+    running.store(false, std::memory_order_release);
+    encoder.join();
+    fclose(file);
+    file = NULL;
+}
+
+bool Recorder::recording() {
+    return file != NULL;
+}
+
+//Frames written so far
+unsigned long long Recorder::frames() {
+    return written.load(std::memory_order_relaxed);
+}
+
+//Frames dropped because the encoder was a whole ring behind
+unsigned long long Recorder::dropped() {
+    return lost.load(std::memory_order_relaxed);
+}
+
+//File size so far
+unsigned long long Recorder::bytes() {
+    return size.load(std::memory_order_relaxed);
+}
+
+std::string Recorder::fileName() {
+    return path;
+}
+
+void Recorder::capture(unsigned long long frame, const unsigned long long display[PLANES][ROWS][WORDS], bool hires,
+                       const Uint32 palette[1 << PLANES], Audio& audio) {
+
+    //Ring full: drop the frame (its audio changes go with the next one)
+    unsigned int h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == SLOTS) {
+        lost.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Slot& slot = slots[h % SLOTS];
+    slot.frame = frame;
+    slot.hires = hires;
+    memcpy(slot.palette, palette, sizeof(slot.palette));
+    memcpy(slot.display, display, sizeof(slot.display));
+
+    slot.events = 0;
+    if (!started) {
+        toEvent(startState, 0, slot.audio[slot.events++]);
+        started = true;
+    }
+
+    //Audio changes since the last slot, as sample offsets into this frame
+    if (audio.historyCount - audioRead > Audio::HISTORY_SIZE) {
+        audioRead = audio.historyCount - Audio::HISTORY_SIZE;
+    }
+    unsigned long long start = frame * audio.samplesPerFrame;
+    for (; audioRead != audio.historyCount; audioRead++)
+    {
+        const Audio::Event& event = audio.history[audioRead & (Audio::HISTORY_SIZE - 1)];
+        unsigned long long offset = event.time > start ? event.time - start : 0;
+        if (offset > audio.samplesPerFrame) {
+            offset = audio.samplesPerFrame;
+        }
+        if (slot.events == MAX_EVENTS) {
+            memmove(slot.audio, slot.audio + 1, (MAX_EVENTS - 1) * sizeof(RecordEvent));
+            slot.events--;
+        }
+        toEvent(event.state, (unsigned short)(offset * FRAME_SAMPLES / audio.samplesPerFrame), slot.audio[slot.events++]);
+    }
+
+    head.store(h + 1, std::memory_order_release);
+}
+
+void Recorder::toEvent(const Audio::State& state, unsigned short offset, RecordEvent& event) {
+    event.offset = offset;
+    event.pitch = state.pitch;
+    event.playing = state.playing ? 1 : 0;
+    memcpy(event.pattern, state.pattern, 16);
+}
+
+//Encoder thread: drain the ring, then sleep a little (the emulation never waits on it)
+void Recorder::run() {
+
+    while (true)
+    {
+        bool stopping = !running.load(std::memory_order_acquire);
+        unsigned int t = tail.load(std::memory_order_relaxed);
+        unsigned int h = head.load(std::memory_order_acquire);
+        for (; t != h; t++)
+        {
+            encode(slots[t % SLOTS]);
+            tail.store(t + 1, std::memory_order_release);
+        }
+        if (stopping) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    fflush(file);
+}
+
+void Recorder::encode(const Slot& slot) {
+
+    bool first = written.load(std::memory_order_relaxed) == 0;
+    bool key = first || slot.hires != previousHires || slot.frame < lastKey || slot.frame - lastKey >= KEYFRAME_INTERVAL;
+    int rows = slot.hires ? ROWS : ROWS / 2;
+    int words = slot.hires ? WORDS : 1;
+
+    //Bitplanes XOR the previous frame, 8 pixels per byte
+    raw.clear();
+    for (int plane = 0; plane < PLANES; plane++)
+    {
+        for (int y = 0; y < rows; y++)
+        {
+            for (int w = 0; w < words; w++)
+            {
+                unsigned long long bits = slot.display[plane][y][w] ^ (key ? 0 : previous[plane][y][w]);
+                for (int shift = 56; shift >= 0; shift -= 8)
+                {
+                    raw.push_back((unsigned char)(bits >> shift));
+                }
+            }
+        }
+    }
+
+    //Runs of 2 or more equal bytes, literals in between
+    coded.clear();
+    size_t i = 0;
+    while (i < raw.size())
+    {
+        size_t run = 1;
+        while (i + run < raw.size() && run < 129 && raw[i + run] == raw[i])
+        {
+            run++;
+        }
+        if (run >= 2) {
+            coded.push_back((unsigned char)(run + 126));
+            coded.push_back(raw[i]);
+            i += run;
+            continue;
+        }
+        size_t start = i;
+        while (i < raw.size() && i - start < 128 && !(i + 1 < raw.size() && raw[i + 1] == raw[i]))
+        {
+            i++;
+        }
+        coded.push_back((unsigned char)(i - start - 1));
+        coded.insert(coded.end(), raw.begin() + start, raw.begin() + i);
+    }
+
+    bool palette = first || memcmp(slot.palette, previousPalette, sizeof(previousPalette)) != 0;
+
+    RecordFrame record;
+    record.frame = (unsigned int)slot.frame;
+    record.videoBytes = (unsigned short)coded.size();
+    record.flags = (key ? RECORD_KEY : 0) | (slot.hires ? RECORD_HIRES : 0) | (palette ? RECORD_PALETTE : 0);
+    record.events = (unsigned char)slot.events;
+
+    unsigned long long length = sizeof(record) + coded.size() + slot.events * sizeof(RecordEvent);
+    fwrite(&record, sizeof(record), 1, file);
+    if (palette) {
+        fwrite(slot.palette, sizeof(slot.palette), 1, file);
+        length += sizeof(slot.palette);
+    }
+    fwrite(coded.data(), 1, coded.size(), file);
+    fwrite(slot.audio, sizeof(RecordEvent), slot.events, file);
+
+    memcpy(previous, slot.display, sizeof(previous));
+    previousHires = slot.hires;
+    memcpy(previousPalette, slot.palette, sizeof(previousPalette));
+    if (key) {
+        lastKey = slot.frame;
+    }
+    size.fetch_add(length, std::memory_order_relaxed);
+    written.fetch_add(1, std::memory_order_relaxed);
+}
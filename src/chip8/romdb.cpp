@@ -0,0 +1,35 @@
+#include <romdb.h>
+#include <string.h>
+
+//Generated from the chip-8-database by build.sh
+#if !__has_include(<romdb_table.h>)
+#error "romdb_table.h is generated by build.sh (see README)"
+#endif
+#include <romdb_table.h>
+
+
+bool romdbLookup(const unsigned char sha1[20], RomProfile& profile) {
+
+    //SHA-1 is already uniformly distributed, its first bytes are the hash
+    unsigned int slot = ((unsigned int)sha1[0] << 24 | (unsigned int)sha1[1] << 16 |
+                         (unsigned int)sha1[2] << 8 | (unsigned int)sha1[3]) & (ROMDB_SLOTS - 1);
+
+    //Linear probing, the table is never more than half full
+    while (romdbSlotTable[slot] >= 0)
+    {
+        const RomDBRecord& record = romdbRecords[romdbSlotTable[slot]];
+        if (memcmp(record.sha1, sha1, 20) == 0) {
+            profile.platform = (Platform)record.platform;
+            profile.quirks = Chip8::quirksFromBits(record.quirks);
+            profile.ipf = record.ipf;
+            profile.title = record.title;
+            return true;
+        }
+        slot = (slot + 1) & (ROMDB_SLOTS - 1);
+    }
+    return false;
+}
+
+unsigned int romdbSize() {
+    return ROMDB_COUNT;
+}
@@ -0,0 +1,312 @@
+#include <romlibrary.h>
+#include <sha1.h>
+#include <romdb.h>
+#include <string.h>
+#include <ctype.h>
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+
+static const char INDEX_MAGIC[4] = { 'C', '8', 'I', 'X' };
+static const unsigned int INDEX_VERSION = 1;
+
+
+RomLibrary::RomLibrary() : running(false), stop(false), gen(0) {
+}
+
+RomLibrary::~RomLibrary() {
+    stop = true;
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void RomLibrary::open(const fs::path& path) {
+    root = path;
+    indexPath = root / ".romindex";
+
+    //Show the cached index right away, then bring it up to date
+    loadIndex();
+    gen++;
+    refresh();
+}
+
+void RomLibrary::refresh() {
+    if (running) {
+        return;
+    }
+    if (worker.joinable()) {
+        worker.join();
+    }
+    running = true;
+    worker = std::thread(&RomLibrary::scan, this);
+}
+
+bool RomLibrary::busy() {
+    return running;
+}
+
+//Bumped whenever the entries change (the UI re-filters when it moves)
+unsigned int RomLibrary::generation() {
+    return gen;
+}
+
+void RomLibrary::snapshot(std::vector<RomEntry>& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    out = entries;
+}
+
+Platform detectPlatform(const fs::path& path, unsigned long long size) {
+
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+    if (ext == ".xo8" || size > 0x1000 - 0x200) {
+        return Platform::XOCHIP;
+    }
+    if (ext == ".sc8" || ext == ".sc") {
+        return Platform::SCHIP;
+    }
+    return Platform::CHIP8;
+}
+
+static bool titleLess(const RomEntry& a, const RomEntry& b) {
+    size_t n = std::min(a.title.size(), b.title.size());
+    for (size_t i = 0; i < n; i++)
+    {
+        int ca = tolower((unsigned char)a.title[i]);
+        int cb = tolower((unsigned char)b.title[i]);
+        if (ca != cb) {
+            return ca < cb;
+        }
+    }
+    if (a.title.size() != b.title.size()) {
+        return a.title.size() < b.title.size();
+    }
+    return a.path < b.path;
+}
+
+void RomLibrary::scan() {
+
+    //Previous entries by path
+    std::vector<RomEntry> old;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        old = entries;
+    }
+    std::unordered_map<std::string, size_t> byPath;
+    for (size_t i = 0; i < old.size(); i++)
+    {
+        byPath[old[i].path] = i;
+    }
+
+    //Walk the folder, only stat() files (no reads)
+    std::vector<RomEntry> found;
+    size_t fresh = 0;
+    std::error_code ec;
+    fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec);
+    fs::recursive_directory_iterator end;
+    for (; !ec && it != end; it.increment(ec))
+    {
+        if (stop) {
+            running = false;
+            return;
+        }
+
+        const fs::directory_entry& entry = *it;
+        std::string name = entry.path().filename().string();
+
+        //Ignore hidden files and folders (.gitignore, .romindex)
+        if (name.empty() || name[0] == '.') {
+            if (entry.is_directory(ec)) {
+                it.disable_recursion_pending();
+            }
+            continue;
+        }
+        if (!entry.is_regular_file(ec)) {
+            continue;
+        }
+
+        RomEntry rom;
+        rom.path = entry.path().string();
+        rom.size = entry.file_size(ec);
+        rom.mtime = (long long)entry.last_write_time(ec).time_since_epoch().count();
+
+        //Unchanged since the last scan: keep the cached entry
+        auto cached = byPath.find(rom.path);
+        if (cached != byPath.end()) {
+            const RomEntry& prev = old[cached->second];
+            if (prev.hashed && prev.size == rom.size && prev.mtime == rom.mtime) {
+                found.push_back(prev);
+                continue;
+            }
+        }
+
+        rom.title = entry.path().stem().string();
+        rom.platform = detectPlatform(entry.path(), rom.size);
+        rom.hashed = false;
+        memset(rom.sha1, 0, sizeof(rom.sha1));
+        found.push_back(rom);
+        fresh++;
+    }
+
+    bool changed = fresh > 0 || found.size() != old.size();
+    std::sort(found.begin(), found.end(), titleLess);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries = found;
+    }
+    gen++;
+
+    //Hash new and modified files
+    size_t hashedCount = 0;
+    for (size_t i = 0; i < found.size() && !stop; i++)
+    {
+        if (found[i].hashed) {
+            continue;
+        }
+
+        unsigned char digest[20];
+        if (!SHA1::hashFile(found[i].path, digest)) {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        memcpy(entries[i].sha1, digest, 20);
+        entries[i].hashed = true;
+
+        //Known ROM: take platform and title from the ROM database
+        RomProfile profile;
+        if (romdbLookup(digest, profile)) {
+            entries[i].platform = profile.platform;
+            entries[i].title = profile.title;
+        }
+        if (++hashedCount % 64 == 0) {
+            gen++;
+        }
+    }
+    gen++;
+
+    if (changed && !stop) {
+        saveIndex();
+    }
+
+    running = false;
+}
+
+/*
+    Index File (little endian)
+        char[4]  "C8IX"
+        u32      version
+        u32      entry count
+        entries:
+            u16 path length, path
+            u16 title length, title
+            u64 size
+            i64 mtime
+            u8[20] sha1
+            u8 platform
+            u8 hashed
+*/
+
+template <typename T>
+static void writeValue(std::ofstream& out, T value) {
+    out.write((const char*)&value, sizeof(T));
+}
+
+template <typename T>
+static bool readValue(std::ifstream& in, T& value) {
+    return (bool)in.read((char*)&value, sizeof(T));
+}
+
+static void writeString(std::ofstream& out, const std::string& value) {
+    writeValue<unsigned short>(out, (unsigned short)value.size());
+    out.write(value.data(), value.size());
+}
+
+static bool readString(std::ifstream& in, std::string& value) {
+    unsigned short length;
+    if (!readValue(in, length)) {
+        return false;
+    }
+    value.resize(length);
+    return (bool)in.read(&value[0], length);
+}
+
+bool RomLibrary::loadIndex() {
+
+    std::ifstream in(indexPath, std::ios::in | std::ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+
+    char magic[4];
+    unsigned int version;
+    unsigned int count;
+    if (!in.read(magic, 4) || memcmp(magic, INDEX_MAGIC, 4) != 0 ||
+        !readValue(in, version) || version != INDEX_VERSION || !readValue(in, count)) {
+        return false;
+    }
+
+    std::vector<RomEntry> loaded;
+    loaded.reserve(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        RomEntry rom;
+        unsigned char platform;
+        unsigned char hashed;
+        if (!readString(in, rom.path) || !readString(in, rom.title) ||
+            !readValue(in, rom.size) || !readValue(in, rom.mtime) ||
+            !in.read((char*)rom.sha1, 20) || !readValue(in, platform) || !readValue(in, hashed)) {
+            return false;
+        }
+        rom.platform = (Platform)platform;
+        rom.hashed = hashed != 0;
+        loaded.push_back(rom);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.swap(loaded);
+    return true;
+}
+
+bool RomLibrary::saveIndex() {
+
+    std::vector<RomEntry> current;
+    snapshot(current);
+
+    //Write to a temporary file first so a crash never leaves a torn index
+    fs::path temp = indexPath;
+    temp += ".tmp";
+    {
+        std::ofstream out(temp, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            return false;
+        }
+
+        out.write(INDEX_MAGIC, 4);
+        writeValue<unsigned int>(out, INDEX_VERSION);
+        writeValue<unsigned int>(out, (unsigned int)current.size());
+        for (const RomEntry& rom : current)
+        {
+            writeString(out, rom.path);
+            writeString(out, rom.title);
+            writeValue(out, rom.size);
+            writeValue(out, rom.mtime);
+            out.write((const char*)rom.sha1, 20);
+            writeValue<unsigned char>(out, (unsigned char)rom.platform);
+            writeValue<unsigned char>(out, rom.hashed ? 1 : 0);
+        }
+        if (!out) {
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(temp, indexPath, ec);
+    return !ec;
+}
@@ -0,0 +1,149 @@
+#include <sha1.h>
+#include <string.h>
+#include <fstream>
+
+
+static inline uint32_t rol(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+SHA1::SHA1() {
+    state[0] = 0x67452301;
+    state[1] = 0xEFCDAB89;
+    state[2] = 0x98BADCFE;
+    state[3] = 0x10325476;
+    state[4] = 0xC3D2E1F0;
+    count = 0;
+}
+
+void SHA1::transform(const unsigned char block[64]) {
+
+    uint32_t w[80];
+
+    //Message Schedule (big endian words)
+    for (int i = 0; i < 16; i++)
+    {
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+               ((uint32_t)block[i * 4 + 2] << 8) | (uint32_t)block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++)
+    {
+        w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = state[0];
+    uint32_t b = state[1];
+    uint32_t c = state[2];
+    uint32_t d = state[3];
+    uint32_t e = state[4];
+
+    for (int i = 0; i < 80; i++)
+    {
+        uint32_t f;
+        uint32_t k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+
+        uint32_t temp = rol(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rol(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+void SHA1::update(const void* data, size_t length) {
+
+    const unsigned char* bytes = (const unsigned char*)data;
+    size_t used = count % 64;
+    count += length;
+
+    //Fill a partial block first
+    if (used > 0) {
+        size_t take = 64 - used < length ? 64 - used : length;
+        memcpy(buffer + used, bytes, take);
+        bytes += take;
+        length -= take;
+        if (used + take < 64) {
+            return;
+        }
+        transform(buffer);
+    }
+
+    //Whole blocks straight from the input
+    while (length >= 64)
+    {
+        transform(bytes);
+        bytes += 64;
+        length -= 64;
+    }
+
+    memcpy(buffer, bytes, length);
+}
+
+void SHA1::final(unsigned char digest[20]) {
+
+    uint64_t bits = count * 8;
+    unsigned char pad[72] = { 0x80 };
+    size_t used = count % 64;
+    size_t padLength = used < 56 ? 56 - used : 120 - used;
+
+    //Length in bits, big endian
+    for (int i = 0; i < 8; i++)
+    {
+        pad[padLength + i] = (unsigned char)(bits >> (56 - i * 8));
+    }
+    update(pad, padLength + 8);
+
+    for (int i = 0; i < 20; i++)
+    {
+        digest[i] = (unsigned char)(state[i / 4] >> (24 - (i % 4) * 8));
+    }
+}
+
+std::string SHA1::toHex(const unsigned char digest[20]) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(40, '0');
+    for (int i = 0; i < 20; i++)
+    {
+        hex[i * 2] = digits[digest[i] >> 4];
+        hex[i * 2 + 1] = digits[digest[i] & 0xF];
+    }
+    return hex;
+}
+
+bool SHA1::hashFile(const std::string& fileName, unsigned char digest[20]) {
+
+    std::ifstream infile(fileName, std::ios::in | std::ios::binary);
+    if (!infile.is_open()) {
+        return false;
+    }
+
+    SHA1 sha;
+    char chunk[16384];
+    while (infile)
+    {
+        infile.read(chunk, sizeof(chunk));
+        sha.update(chunk, (size_t)infile.gcount());
+    }
+    sha.final(digest);
+    return true;
+}
@@ -0,0 +1,105 @@
+#include <threadpool.h>
+#include <algorithm>
+
+
+ThreadPool::ThreadPool() {
+    started = false;
+    stopping = false;
+    job = nullptr;
+    jobRows = 0;
+    bandCount = 0;
+    nextBand = 0;
+    pending = 0;
+    generation = 0;
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+//One worker per spare core, at most MAX_WORKERS
+void ThreadPool::start() {
+    int cores = (int)std::thread::hardware_concurrency();
+    int count = std::min(MAX_WORKERS, std::max(0, cores - 1));
+    for (int i = 0; i < count; i++)
+    {
+        workers.emplace_back([this]() {
+            unsigned long long seen = 0;
+            for (;;)
+            {
+                {
+                    std::unique_lock<std::mutex> guard(mutex);
+                    wake.wait(guard, [&]() { return stopping || generation != seen; });
+                    if (stopping) {
+                        return;
+                    }
+                    seen = generation;
+                }
+                runBands();
+            }
+        });
+    }
+}
+
+//Run work(first, last) over rows 0..rows-1, one band per thread
+void ThreadPool::bands(int rows, const std::function<void(int first, int last)>& work) {
+
+    if (!started) {
+        started = true;
+        start();
+    }
+
+    int count = std::min(rows, (int)workers.size() + 1);
+    if (count <= 1) {
+        work(0, rows);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        job = &work;
+        jobRows = rows;
+        bandCount = count;
+        nextBand = 0;
+        pending = count;
+        generation++;
+    }
+    wake.notify_all();
+
+    //The caller takes bands as well
+    runBands();
+
+    std::unique_lock<std::mutex> guard(mutex);
+    done.wait(guard, [this]() { return pending == 0; });
+    job = nullptr;
+}
+
+//Take bands of the current job until none are left
+void ThreadPool::runBands() {
+    for (;;)
+    {
+        int band;
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            if (job == nullptr || nextBand >= bandCount) {
+                return;
+            }
+            band = nextBand++;
+        }
+
+        (*job)(band * jobRows / bandCount, (band + 1) * jobRows / bandCount);
+
+        std::lock_guard<std::mutex> guard(mutex);
+        if (--pending == 0) {
+            done.notify_all();
+        }
+    }
+}
@@ -0,0 +1,249 @@
+#include <tracer.h>
+#include <string.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+Tracer::Tracer() {
+    window = NULL;
+    windowOffset = 0;
+    used = 0;
+    count = 0;
+#ifdef _WIN32
+    file = NULL;
+    mapping = NULL;
+#else
+    file = -1;
+#endif
+}
+
+Tracer::~Tracer() {
+    close();
+}
+
+bool Tracer::open(const std::string& fileName, std::string& error) {
+
+    close();
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(fileName.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        error = "Can't create " + fileName;
+        return false;
+    }
+    file = handle;
+#else
+    file = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) {
+        error = "Can't create " + fileName;
+        return false;
+    }
+#endif
+
+    path = fileName;
+    count = 0;
+    if (!mapWindow(0)) {
+        error = "Can't map " + fileName;
+        close();
+        return false;
+    }
+
+    TraceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, 4);
+    header.version = TRACE_VERSION;
+    header.recordSize = sizeof(TraceRecord);
+    put(&header, sizeof(header));
+    return true;
+}
+
+//Unmap and cut the file down to what was written
+void Tracer::close() {
+
+    if (!recording()) {
+        return;
+    }
+    unsigned long long size = windowOffset + used;
+    unmapWindow();
+    writeCount();
+
+#ifdef _WIN32
+    LARGE_INTEGER end;
+    end.QuadPart = (LONGLONG)size;
+    SetFilePointerEx((HANDLE)file, end, NULL, FILE_BEGIN);
+    SetEndOfFile((HANDLE)file);
+    CloseHandle((HANDLE)file);
+    file = NULL;
+#else
+    if (ftruncate(file, (off_t)size) != 0) {
+        //The zero filled tail stays, the record count in the header ends the trace
+    }
+    ::close(file);
+    file = -1;
+#endif
+}
+
+bool Tracer::recording() {
+#ifdef _WIN32
+    return file != NULL;
+#else
+    return file >= 0;
+#endif
+}
+
+unsigned long long Tracer::records() {
+    return count;
+}
+
+std::string Tracer::fileName() {
+    return path;
+}
+
+//Grow the file and map [offset, offset + WINDOW)
+bool Tracer::mapWindow(unsigned long long offset) {
+
+    unsigned long long end = offset + WINDOW;
+
+#ifdef _WIN32
+    mapping = CreateFileMappingA((HANDLE)file, NULL, PAGE_READWRITE, (DWORD)(end >> 32), (DWORD)end, NULL);
+    if (mapping == NULL) {
+        return false;
+    }
+    window = (unsigned char*)MapViewOfFile((HANDLE)mapping, FILE_MAP_WRITE, (DWORD)(offset >> 32), (DWORD)offset, WINDOW);
+    if (window == NULL) {
+        CloseHandle((HANDLE)mapping);
+        mapping = NULL;
+        return false;
+    }
+#else
+    if (ftruncate(file, (off_t)end) != 0) {
+        return false;
+    }
+    void* view = mmap(NULL, WINDOW, PROT_READ | PROT_WRITE, MAP_SHARED, file, (off_t)offset);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    window = (unsigned char*)view;
+#endif
+
+    windowOffset = offset;
+    used = 0;
+    return true;
+}
+
+//Store the number of complete records in the header (written past the mapped view)
+void Tracer::writeCount() {
+    if (windowOffset + used < sizeof(TraceHeader)) {
+        return;
+    }
+    unsigned long long complete = (windowOffset + used - sizeof(TraceHeader)) / sizeof(TraceRecord);
+#ifdef _WIN32
+    OVERLAPPED at;
+    memset(&at, 0, sizeof(at));
+    at.Offset = offsetof(TraceHeader, records);
+    DWORD written;
+    WriteFile((HANDLE)file, &complete, sizeof(complete), &written, &at);
+#else
+    if (pwrite(file, &complete, sizeof(complete), offsetof(TraceHeader, records)) != sizeof(complete)) {
+        //Readers then stop at the count of the previous window
+    }
+#endif
+}
+
+void Tracer::unmapWindow() {
+    if (window == NULL) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(window);
+    CloseHandle((HANDLE)mapping);
+    mapping = NULL;
+#else
+    munmap(window, WINDOW);
+#endif
+    window = NULL;
+}
+
+//Copy into the mapped view, moving to the next window when it is full
+void Tracer::put(const void* data, unsigned int length) {
+
+    const unsigned char* bytes = (const unsigned char*)data;
+    while (length > 0 && window != NULL)
+    {
+        unsigned int room = WINDOW - used;
+        unsigned int chunk = length < room ? length : room;
+        memcpy(window + used, bytes, chunk);
+        used += chunk;
+        bytes += chunk;
+        length -= chunk;
+
+        if (used == WINDOW) {
+            unsigned long long next = windowOffset + WINDOW;
+            unmapWindow();
+            writeCount();
+            if (!mapWindow(next)) {
+                //Disk full or similar: stop tracing, keep what was written
+                windowOffset = next;
+                used = 0;
+                close();
+                return;
+            }
+        }
+    }
+}
+
+void Tracer::write(const TraceRecord& record) {
+    put(&record, sizeof(record));
+    count++;
+}
+
+bool Tracer::addPoint(unsigned short start, unsigned short end, unsigned short mask, unsigned short match,
+                      const std::string& condition, std::string& error) {
+
+    TracePoint point;
+    point.start = start <= end ? start : end;
+    point.end = start <= end ? end : start;
+    point.mask = mask;
+    point.match = match & mask;
+    point.conditional = false;
+    point.text = condition;
+
+    if (condition.find_first_not_of(" \t") != std::string::npos) {
+        if (!Debugger::parseCondition(condition, point.condition, error)) {
+            return false;
+        }
+        point.conditional = true;
+    }
+    points.push_back(point);
+    return true;
+}
+
+void Tracer::removePoint(size_t i) {
+    if (i < points.size()) {
+        points.erase(points.begin() + i);
+    }
+}
+
+//Evaluated before the instruction runs
+bool Tracer::matches(unsigned short pc, unsigned short opcode, const unsigned char v[16], unsigned short index,
+                     unsigned char delay, unsigned char sound, unsigned char sp) {
+
+    if (points.empty()) {
+        return true;
+    }
+    for (const TracePoint& point : points)
+    {
+        if (pc >= point.start && pc <= point.end && (opcode & point.mask) == point.match &&
+                (!point.conditional || Debugger::test(point.condition, v, index, delay, sound, sp))) {
+            return true;
+        }
+    }
+    return false;
+}
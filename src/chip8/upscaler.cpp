@@ -0,0 +1,390 @@
+#include <upscaler.h>
+#include <string.h>
+
+typedef unsigned long long Word;
+
+static const int PLANES = Upscaler::PLANES;
+
+
+void Upscaler::Packed::resize(int width, int height) {
+    this->width = width;
+    this->height = height;
+    words = (width + 63) / 64;
+    bits.assign((size_t)PLANES * height * words, 0);
+}
+
+Word* Upscaler::Packed::row(int plane, int y) {
+    return &bits[((size_t)plane * height + y) * words];
+}
+
+const Word* Upscaler::Packed::row(int plane, int y) const {
+    return &bits[((size_t)plane * height + y) * words];
+}
+
+
+//Pixels around one word of a row: at(dx, dy)[plane] holds the pixels at
+//(x + dx, y + dy) for the 64 x of the word, clamped at the image edges
+struct Neighbourhood {
+    Word n[5][5][PLANES];
+
+    const Word* at(int dx, int dy) const {
+        return n[dy + 2][dx + 2];
+    }
+};
+
+//Word w of a packed row moved by dx pixels (pixel x gets pixel x + dx)
+static Word shifted(const Word* row, int words, int w, int dx) {
+    if (dx == 0) {
+        return row[w];
+    }
+    if (dx > 0) {
+        Word next = w + 1 < words ? row[w + 1] >> (64 - dx) : ((row[words - 1] & 1) ? (1ULL << dx) - 1 : 0);
+        return (row[w] << dx) | next;
+    }
+    int m = -dx;
+    Word previous = w > 0 ? row[w - 1] << (64 - m) : ((row[0] >> 63) ? ~0ULL << (64 - m) : 0);
+    return (row[w] >> m) | previous;
+}
+
+static void gather(const Upscaler::Packed& image, int y, int w, Neighbourhood& n) {
+    for (int dy = -2; dy <= 2; dy++)
+    {
+        int r = y + dy < 0 ? 0 : (y + dy >= image.height ? image.height - 1 : y + dy);
+        for (int plane = 0; plane < PLANES; plane++)
+        {
+            const Word* row = image.row(plane, r);
+            for (int dx = -2; dx <= 2; dx++)
+            {
+                n.n[dy + 2][dx + 2][plane] = shifted(row, image.words, w, dx);
+            }
+        }
+    }
+}
+
+//Pixels that differ in any plane
+static inline Word ne(const Word* a, const Word* b) {
+    Word differ = 0;
+    for (int plane = 0; plane < PLANES; plane++)
+    {
+        differ |= a[plane] ^ b[plane];
+    }
+    return differ;
+}
+
+static inline Word eq(const Word* a, const Word* b) {
+    return ~ne(a, b);
+}
+
+//mask ? pixel : e, in every plane
+static inline void select(Word mask, const Word* pixel, const Word* e, Word* out) {
+    for (int plane = 0; plane < PLANES; plane++)
+    {
+        out[plane] = (mask & pixel[plane]) | (~mask & e[plane]);
+    }
+}
+
+//Sub-pixels of the 64 pixels of a word: sub[row][column][plane]
+typedef void (*Rule)(const Neighbourhood& n, Word sub[3][3][PLANES]);
+
+static void scale2x(const Neighbourhood& n, Word sub[3][3][PLANES]) {
+    const Word* e = n.at(0, 0);
+    const Word* b = n.at(0, -1);
+    const Word* d = n.at(-1, 0);
+    const Word* f = n.at(1, 0);
+    const Word* h = n.at(0, 1);
+    Word db = eq(d, b);
+    Word bf = eq(b, f);
+    Word dh = eq(d, h);
+    Word hf = eq(h, f);
+    select(db & ~bf & ~dh, d, e, sub[0][0]);
+    select(bf & ~db & ~hf, f, e, sub[0][1]);
+    select(dh & ~db & ~hf, d, e, sub[1][0]);
+    select(hf & ~dh & ~bf, f, e, sub[1][1]);
+}
+
+static void scale3x(const Neighbourhood& n, Word sub[3][3][PLANES]) {
+    const Word* a = n.at(-1, -1);
+    const Word* b = n.at(0, -1);
+    const Word* c = n.at(1, -1);
+    const Word* d = n.at(-1, 0);
+    const Word* e = n.at(0, 0);
+    const Word* f = n.at(1, 0);
+    const Word* g = n.at(-1, 1);
+    const Word* h = n.at(0, 1);
+    const Word* i = n.at(1, 1);
+    Word db = eq(d, b);
+    Word bf = eq(b, f);
+    Word dh = eq(d, h);
+    Word hf = eq(h, f);
+
+    //Corners that take a neighbour (as in Scale2x)
+    Word topLeft = db & ~bf & ~dh;
+    Word topRight = bf & ~db & ~hf;
+    Word bottomLeft = dh & ~db & ~hf;
+    Word bottomRight = hf & ~dh & ~bf;
+
+    select(topLeft, d, e, sub[0][0]);
+    select((topLeft & ne(e, c)) | (topRight & ne(e, a)), b, e, sub[0][1]);
+    select(topRight, f, e, sub[0][2]);
+    select((topLeft & ne(e, g)) | (bottomLeft & ne(e, a)), d, e, sub[1][0]);
+    select(0, e, e, sub[1][1]);
+    select((topRight & ne(e, i)) | (bottomRight & ne(e, c)), f, e, sub[1][2]);
+    select(bottomLeft, d, e, sub[2][0]);
+    select((bottomLeft & ne(e, i)) | (bottomRight & ne(e, g)), h, e, sub[2][1]);
+    select(bottomRight, f, e, sub[2][2]);
+}
+
+//Bit-sliced count of four one-bit values (0-4 in bits s0-s2)
+struct Count {
+    Word s0;
+    Word s1;
+    Word s2;
+};
+
+static inline Count count4(Word a, Word b, Word c, Word d) {
+    Word ab = a ^ b;
+    Word cd = c ^ d;
+    Word carry = ab & cd;
+    Count count;
+    count.s0 = ab ^ cd;
+    count.s1 = (a & b) ^ (c & d) ^ carry;
+    count.s2 = a & b & c & d;
+    return count;
+}
+
+static inline Word less(const Count& x, const Count& y) {
+    Word same2 = ~(x.s2 ^ y.s2);
+    Word same1 = ~(x.s1 ^ y.s1);
+    return (~x.s2 & y.s2) | (same2 & ((~x.s1 & y.s1) | (same1 & ~x.s0 & y.s0)));
+}
+
+//One 2xBR corner, mirrored by (sx, sy): the corner towards F = (sx, 0) and H = (0, sy)
+static void xbrCorner(const Neighbourhood& n, int sx, int sy, Word* out) {
+    const Word* e = n.at(0, 0);
+    const Word* b = n.at(0, -sy);
+    const Word* c = n.at(sx, -sy);
+    const Word* d = n.at(-sx, 0);
+    const Word* f = n.at(sx, 0);
+    const Word* g = n.at(-sx, sy);
+    const Word* h = n.at(0, sy);
+    const Word* i = n.at(sx, sy);
+    const Word* f4 = n.at(2 * sx, 0);
+    const Word* h5 = n.at(0, 2 * sy);
+    const Word* i4 = n.at(2 * sx, sy);
+    const Word* i5 = n.at(sx, 2 * sy);
+
+    //wd1 = d(E,C) + d(E,G) + d(I,F4) + d(I,H5) + 4 d(H,F)
+    //wd2 = d(H,D) + d(H,I5) + d(F,I4) + d(F,B) + 4 d(E,I), edge when wd1 < wd2
+    Count near = count4(ne(e, c), ne(e, g), ne(i, f4), ne(i, h5));
+    Count far = count4(ne(h, d), ne(h, i5), ne(f, i4), ne(f, b));
+    Word across = ne(h, f);
+    Word along = ne(e, i);
+    Word farZero = ~(far.s0 | far.s1 | far.s2);
+    Word edge = (~across & along & ~(near.s2 & farZero)) | (~(across ^ along) & less(near, far));
+
+    //Colour distances are 0 or 1, so F wins the tie with H
+    select(edge & ne(e, f) & ne(e, h), f, e, out);
+}
+
+static void xbr(const Neighbourhood& n, Word sub[3][3][PLANES]) {
+    xbrCorner(n, -1, -1, sub[0][0]);
+    xbrCorner(n, 1, -1, sub[0][1]);
+    xbrCorner(n, -1, 1, sub[1][0]);
+    xbrCorner(n, 1, 1, sub[1][1]);
+}
+
+//SPREAD[k][byte]: the 8 pixels of byte k apart (first pixel at bit 8k - 1)
+static Word SPREAD[4][256];
+
+static bool buildSpread() {
+    for (int k = 1; k <= 3; k++)
+    {
+        for (int value = 0; value < 256; value++)
+        {
+            Word spread = 0;
+            for (int i = 0; i < 8; i++)
+            {
+                if (value & (0x80 >> i)) {
+                    spread |= 1ULL << (8 * k - 1 - i * k);
+                }
+            }
+            SPREAD[k][value] = spread;
+        }
+    }
+    return true;
+}
+
+static const bool spreadReady = buildSpread();
+
+//OR the bits (length of them, first at the top) into out from bit position
+//(counted from the top of out[0]), dropping what falls past words
+static inline void place(Word* out, int words, int position, Word bits, int length) {
+    int w = position / 64;
+    int offset = position % 64;
+    if (offset + length <= 64) {
+        out[w] |= bits << (64 - offset - length);
+        return;
+    }
+    out[w] |= bits >> (offset + length - 64);
+    if (w + 1 < words) {
+        out[w + 1] |= bits << (128 - offset - length);
+    }
+}
+
+//Output pixel x * k + s is pixel x of column s (64 pixels in, k words out)
+static void interleave(const Word* columns, int k, Word* out) {
+    for (int o = 0; o < k; o++)
+    {
+        out[o] = 0;
+    }
+    for (int s = 0; s < k; s++)
+    {
+        for (int byte = 0; byte < 8; byte++)
+        {
+            Word spread = SPREAD[k][(columns[s] >> (56 - 8 * byte)) & 0xFF];
+            place(out, k, 8 * byte * k + s, spread, 8 * k);
+        }
+    }
+}
+
+//in scaled by k with rule (in rows of whole words)
+static void upscale(const Upscaler::Packed& in, Upscaler::Packed& out, int k, Rule rule, ThreadPool& pool) {
+
+    out.resize(in.width * k, in.height * k);
+    pool.bands(in.height, [&](int first, int last) {
+        Neighbourhood n;
+        Word sub[3][3][PLANES];
+        Word columns[3];
+        for (int y = first; y < last; y++)
+        {
+            for (int w = 0; w < in.words; w++)
+            {
+                gather(in, y, w, n);
+                rule(n, sub);
+                for (int sy = 0; sy < k; sy++)
+                {
+                    for (int plane = 0; plane < PLANES; plane++)
+                    {
+                        for (int s = 0; s < k; s++)
+                        {
+                            columns[s] = sub[sy][s][plane];
+                        }
+                        interleave(columns, k, out.row(plane, y * k + sy) + w * k);
+                    }
+                }
+            }
+        }
+    });
+}
+
+
+Upscaler::Upscaler() {
+    mode = NONE;
+    output.assign((size_t)STRIDE * ROWS * MAX_FACTOR, 0xFF000000);
+    valid = false;
+    cachedWidth = 0;
+    cachedHeight = 0;
+    cachedMode = NONE;
+    memset(cached, 0, sizeof(cached));
+    memset(cachedPalette, 0, sizeof(cachedPalette));
+}
+
+int Upscaler::factor() {
+    switch (mode) {
+        case SCALE2X:
+        case XBR:
+            return 2;
+        case SCALE3X:
+            return 3;
+        case SCALE4X:
+            return 4;
+        default:
+            return 1;
+    }
+}
+
+const char* Upscaler::name(int mode) {
+    static const char* names[MODES] = { "None", "Scale2x (EPX)", "Scale3x", "Scale4x", "xBR" };
+    return mode >= 0 && mode < MODES ? names[mode] : "?";
+}
+
+//Colours of the last frame, width x height times factor() (STRIDE pixels per row)
+const Uint32* Upscaler::frame() {
+    return output.data();
+}
+
+//Scale the top left width x height of display and expand it into colours.
+//Returns false when frame() already holds this display.
+bool Upscaler::process(const unsigned long long display[PLANES][ROWS][WORDS], int width, int height,
+        const Uint32 palette[1 << PLANES], ThreadPool& pool) {
+
+    int words = width / 64;
+    bool same = valid && width == cachedWidth && height == cachedHeight && mode == cachedMode &&
+        memcmp(palette, cachedPalette, sizeof(cachedPalette)) == 0;
+    for (int plane = 0; plane < PLANES && same; plane++)
+    {
+        for (int y = 0; y < height && same; y++)
+        {
+            same = memcmp(display[plane][y], cached[plane][y], words * sizeof(Word)) == 0;
+        }
+    }
+    if (same) {
+        return false;
+    }
+
+    memcpy(cached, display, sizeof(cached));
+    memcpy(cachedPalette, palette, sizeof(cachedPalette));
+    cachedWidth = width;
+    cachedHeight = height;
+    cachedMode = mode;
+    valid = true;
+
+    source.resize(width, height);
+    for (int plane = 0; plane < PLANES; plane++)
+    {
+        for (int y = 0; y < height; y++)
+        {
+            memcpy(source.row(plane, y), display[plane][y], words * sizeof(Word));
+        }
+    }
+
+    const Packed* result = &source;
+    switch (mode) {
+        case SCALE2X:
+            upscale(source, scaled, 2, scale2x, pool);
+            result = &scaled;
+            break;
+        case SCALE3X:
+            upscale(source, scaled, 3, scale3x, pool);
+            result = &scaled;
+            break;
+        case SCALE4X:
+            upscale(source, doubled, 2, scale2x, pool);
+            upscale(doubled, scaled, 2, scale2x, pool);
+            result = &scaled;
+            break;
+        case XBR:
+            upscale(source, scaled, 2, xbr, pool);
+            result = &scaled;
+            break;
+    }
+
+    //Palette
+    pool.bands(result->height, [&](int first, int last) {
+        for (int y = first; y < last; y++)
+        {
+            Uint32* out = &output[(size_t)y * STRIDE];
+            const Word* plane0 = result->row(0, y);
+            const Word* plane1 = result->row(1, y);
+            for (int w = 0; w < result->words; w++)
+            {
+                for (int x = 0; x < 64; x++)
+                {
+                    int colour = (int)((plane0[w] >> (63 - x)) & 1) | (int)((plane1[w] >> (63 - x)) & 1) << 1;
+                    out[w * 64 + x] = palette[colour];
+                }
+            }
+        }
+    });
+    return true;
+}
@@ -0,0 +1,81 @@
+// audio.h
+#ifndef audio_h
+#define audio_h
+#include <SDL.h>
+#include <atomic>
+
+/*
+    XO-CHIP Audio
+
+    The sound is a 16 byte (128 bit) 1-bit pattern played back at
+    4000 * 2^((pitch - 64) / 48) bits per second while the sound timer is
+    running. Plain CHIP-8 programs never touch the pattern or the pitch and
+    just hear the default square wave.
+
+    The emulation side never touches the audio device: every change is sent
+    as a full state snapshot, stamped with the emulated time in samples,
+    through a single-producer/single-consumer queue. The audio callback applies
+    each snapshot at its exact sample offset.
+*/
+class Audio {
+
+    public:
+        static const int SAMPLE_RATE = 48000;
+        static const unsigned char DEFAULT_PITCH = 64;
+
+        struct State {
+            unsigned char pattern[16];
+            unsigned char pitch;
+            bool playing;
+        };
+
+        struct Event {
+            unsigned long long time;
+            State state;
+        };
+
+        static const unsigned int HISTORY_SIZE = 64;  // Power of two
+
+        unsigned int samplesPerFrame;       // Host samples per 60 Hz frame
+        Event history[HISTORY_SIZE];        // Last state changes, for the Recorder (emulation side)
+        unsigned int historyCount;          // Changes sent so far
+
+        Audio();
+        void init();
+        void close();
+        void reset(unsigned long long time);
+        void setPlaying(bool playing, unsigned long long time);
+        void setPattern(const unsigned char* pattern, unsigned long long time);
+        void setPitch(unsigned char pitch, unsigned long long time);
+        void flush(unsigned long long now);
+        State current();
+
+    private:
+        static const unsigned int QUEUE_SIZE = 256;   // Power of two
+
+        //Emulation side
+        State state;
+        bool pending;
+        unsigned long long pendingTime;
+
+        //Shared
+        Event queue[QUEUE_SIZE];
+        std::atomic<unsigned int> head;
+        std::atomic<unsigned int> tail;
+        std::atomic<unsigned long long> emuClock;
+
+        //Callback side
+        State playState;
+        unsigned int phase;
+        unsigned long long playClock;
+        bool synced;
+        unsigned int phaseStep[256];    // Phase increment per host sample for each pitch
+        SDL_AudioDeviceID device;
+
+        void send(unsigned long long time);
+        bool push(unsigned long long time);
+        void mix(Sint16* out, int samples);
+        static void callback(void* userdata, Uint8* stream, int len);
+};
+
+#endif
@@ -0,0 +1,57 @@
+// callgraph.h
+#ifndef callgraph_h
+#define callgraph_h
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+/*
+    Call Graph Profiler
+
+    Follows 2NNN (CALL) and 00EE (RET) to keep a call tree keyed by
+    subroutine entry addresses. Instructions are attributed to the node of
+    the subroutine that is running; with a sample interval N only every
+    Nth instruction is counted (with weight N).
+
+    The tree can be exported as folded stacks (flamegraph.pl, inferno) or
+    as a speedscope "sampled" profile.
+*/
+class CallGraph {
+
+    public:
+        static const size_t MAX_NODES = 1 << 16;
+
+        struct Node {
+            unsigned short address;         // Subroutine entry (root: program start)
+            int parent;
+            int firstChild;
+            int nextSibling;
+            unsigned long long self;        // Instructions attributed to this node
+            unsigned long long calls;
+        };
+
+        bool enabled;
+        unsigned int interval;              // Count every Nth instruction
+        std::vector<Node> nodes;
+        int current;
+
+        CallGraph();
+
+        void reset(unsigned short entry);
+        void sample();
+        void enter(unsigned short address);
+        void leave();
+
+        unsigned long long total(int node);
+        std::string name(int node);
+        bool saveFolded(const std::string& path);
+        bool saveSpeedscope(const std::string& path, const std::string& title);
+
+    private:
+        unsigned int untilSample;
+        int overflow;                       // Calls deeper than the node limit
+
+        int child(int parent, unsigned short address);
+};
+
+#endif
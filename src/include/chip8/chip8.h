@@ -2,15 +2,53 @@
 #ifndef chip8_h
 #define chip8_h
 #include "graphics.h"
+#include "audio.h"
+#include "debugger.h"
+#include "journal.h"
+#include "profiler.h"
+#include "callgraph.h"
+#include "tracer.h"
+#include "recorder.h"
+#include "quirks.h"
 #include <iostream>
 #include <fstream>
 #include <stack>
 #include <map>
+#include <vector>
 
 
+//Instrumentation compiled into the dispatch loop (one instantiation per combination)
+enum {
+    HOOK_DEBUG = 1 << 0,            // Breakpoints and watchpoints
+    HOOK_JOURNAL = 1 << 1,          // Undo journal (reverse execution)
+    HOOK_PROFILE = 1 << 2,          // Execution profiler counters
+    HOOK_CALLGRAPH = 1 << 3,        // Call graph profiler (CALL/RET)
+    HOOK_TRACE = 1 << 4             // Trace points (binary trace file)
+};
+static const unsigned int HOOK_COMBINATIONS = 1 << 5;
+
+//ROM Loading
+enum class ROMStatus {
+    OK,
+    NotFound,
+    Empty,
+    TooLarge,
+    ReadError
+};
+
+struct ROMResult {
+    ROMStatus status;
+    size_t size;                // Bytes loaded (or file size when too large)
+    std::string message;
+    bool identified;            // Found in the ROM database
+    std::string title;          // Title from the ROM database
+};
+
+struct RomProfile;
+
 class Chip8
 {
-    unsigned char memory[4096]{};       // 4KB of memory
+    unsigned char memory[0x10000]{};    // 64KB of memory (4KB used by CHIP-8/SCHIP)
     unsigned short stack[16]{};   // 64 16-bit addresses
 
     unsigned char font[80] = {
@@ -32,32 +70,158 @@ class Chip8
         0xF0, 0x80, 0xF0, 0x80, 0x80  // F
     };        
 
+    //SUPER-CHIP 8x10 digits (FX30), stored after the small font
+    unsigned char bigFont[160] = {
+        0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+        0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+        0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+        0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+        0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+        0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+        0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+        0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+    };
+
+    //Display rows saved by journalBegin (DXYN/CLS/scrolling)
+    unsigned char journalRows[DISPLAY_ROWS];
+    unsigned long long journalMasks[DISPLAY_ROWS][DISPLAY_PLANES][DISPLAY_WORDS];
+    int journalRowCount = 0;
+
+    void journalV(unsigned char x);
+    void journalIndex();
+    void journalMemory(unsigned int address);
+    void journalRow(int y);
+    void journalBegin(unsigned short opcode);
+    void journalEnd();
+    bool undo(bool& watchHit);
+
+    unsigned int randomState;
+
+    //Bytes stored to since the last latchWrites() (one bit per address)
+    unsigned long long writtenMemory[0x10000 / 64]{};
+    unsigned long long changedMemory[0x10000 / 64]{};
+
+    void markWritten(unsigned int address);
+
+    //State at the last short backward jump (idle loop detection)
+    struct IdleLoop {
+        int head = -1;                  // Jump target, -1: none
+        unsigned short jump;            // Address of the 1NNN
+        unsigned short step;            // frameStep of the jump
+        unsigned char v[16];
+        unsigned short index;
+        unsigned char sp;
+        unsigned char delay;
+        unsigned char sound;
+        unsigned int random;
+    } idleLoop;
+    static const unsigned short IDLE_LOOP_BYTES = 16;   // Longest loop body checked
+
+    void skipIdle(unsigned short from);
+    bool idleBody(unsigned short head, unsigned short jump);
+
+    ROMResult readROM(const std::string& fileName, std::vector<unsigned char>& data, RomProfile& profile);
+    void skip();
+    void scrollDown(int rows);
+    void scrollUp(int rows);
+    void scrollRight(int pixels);
+    void scrollLeft(int pixels);
+
     public:
         unsigned short pc;                  // 16-bit program counter
         unsigned short index;          // 16-bit index register
         unsigned char sp;
-        unsigned char display[64][32]{};// 64 x 32 monochrome display
+        static const unsigned short BIG_FONT = 0x50;     // Address of the FX30 digits
+
+        //128 x 64 display in XO-CHIP bitplanes, 64 pixels per word (x = 0 is the most
+        //significant bit of word 0). Lo-res (64 x 32) uses word 0 of rows 0-31.
+        unsigned long long display[DISPLAY_PLANES][DISPLAY_ROWS][DISPLAY_WORDS]{};
+        bool hires;                     // SUPER-CHIP 128 x 64 mode (00FF)
+        unsigned char planes;           // XO-CHIP planes drawn/cleared/scrolled (FN01)
+        unsigned char rpl[16]{};        // SUPER-CHIP RPL user flags (FX75/FX85)
         unsigned char v[16]{};          // 16 8-bit general-purpose variable registers
         bool drawFlag;                  //Draw Flag
         Graphics graphics;
+        Audio audio;
+        Debugger debugger;
+        Journal journal;
+        Profiler profiler;
+        CallGraph callGraph;
+        Tracer tracer;
+        Recorder recorder;
         unsigned short lastOpcode;
         unsigned int pressedKey;
         unsigned char delay_timer;          // 8-bit delay timer
         unsigned char sound_timer;          // 8-bit sound timer
+        unsigned short ipf;                 // Instructions per Frame
+        unsigned long long frameCount;      // Emulated 60 Hz frames
+        unsigned short frameStep;           // Instruction index inside the current frame
+        unsigned short waitSkipped;         // Instructions of this frame skipped by the display wait quirk
+        unsigned short lastWaitSkipped;     // Same for the last completed frame
+        bool idleSkip;                      // Fast-forward loops that only wait for the timer or a key
+        unsigned short idleSkipped;         // Instructions of this frame skipped in idle loops
+        unsigned short lastIdleSkipped;     // Same for the last completed frame
         std::map<SDL_Keycode, unsigned int> keymap;
         std::string console[50]{};   // 64 16-bit addresses
+        unsigned int logCount;              // Lines pushed so far (the UI redraws when it moves)
         bool debugMode;
+        Platform platform;
+        Quirks quirks;                      // Change with setQuirks() (selects the interpreter)
+        int quirkProfile;                   // Compiled quirk profile for quirks, -1: QUIRKS_DYNAMIC
+        std::string romPath;                // Last ROM loaded successfully
+        unsigned int pageVersion[0x100]{};  // Bumped on every write to a 256 byte page (disassembly cache)
 
-        Chip8();
+        Chip8(bool headless = false);
         void initGraphics();
         void pushLog(std::string log);
         void pressKey(SDL_Keycode key);
-        void loadROM(std::string fileName);
+        unsigned char nextRandom();
+        void seedRandom(unsigned int seed);
+        std::string displayHash();
+        int displayWidth();
+        int displayHeight();
+        unsigned char pixel(int x, int y);
+        void clearDisplay(unsigned char mask = (1 << DISPLAY_PLANES) - 1);
+        ROMResult loadROM(std::string fileName);
+        unsigned int addressSpace();
+        static Quirks platformQuirks(Platform platform);
+        static Quirks quirksFromBits(unsigned int bits);
+        static unsigned int quirkBits(const Quirks& quirks);
+        void setQuirks(const Quirks& quirks);
+        static unsigned short platformSpeed(Platform platform);
         void unLoadROM();
-        void cycle();
-        void xFinstructions(unsigned short opcode);
-        void x8instructions(unsigned short opcode);
-        void draw(unsigned short opcode);
+        ROMResult reloadROM(bool keepRegisters);
+        unsigned int activeHooks();
+        bool cycle();
+        bool step();
+        template <unsigned int Hooks, unsigned int QuirkBits> void run();
+        template <unsigned int Hooks, unsigned int QuirkBits> void execute();
+        template <unsigned int Hooks> unsigned char readMemory(unsigned int address);
+        template <unsigned int Hooks> void writeMemory(unsigned int address, unsigned char value);
+        unsigned char peek(unsigned int address);
+        void poke(unsigned int address, unsigned char value);
+        void latchWrites();
+        bool changedLastFrame(unsigned int address);
+        void touchMemory(unsigned int address, unsigned int length);
+        bool breakpointHit();
+        bool stepBack();
+        bool reverseContinue();
+        void setResolution(bool high);
+        void updateTimers();
+        unsigned long long audioTime();
+        template <unsigned int Hooks, unsigned int QuirkBits> void xFinstructions(unsigned short opcode);
+        template <unsigned int QuirkBits> void x8instructions(unsigned short opcode);
+        template <unsigned int QuirkBits> void restoreIndex(unsigned short opcode, unsigned short start);
+        template <unsigned int Hooks, unsigned int QuirkBits> void draw(unsigned short opcode);
+        template <unsigned int Hooks, unsigned int QuirkBits> void drawPlane(int plane, unsigned short opcode, unsigned short address, unsigned char& collisions);
         void updateDisplay();
         void destroyGraphics();
 };
@@ -0,0 +1,89 @@
+// debugger.h
+#ifndef debugger_h
+#define debugger_h
+#include <string>
+#include <vector>
+
+/*
+    Debugger
+
+    Breakpoints and watchpoints are kept as a flag per address, so the
+    debug dispatch loop only needs one table lookup per instruction and per
+    memory access. The normal dispatch loop never looks at any of this: the
+    debug loop is only selected while something is armed (see Chip8::cycle).
+*/
+class Debugger {
+
+    public:
+        //Per-address flags
+        enum {
+            BREAK       = 1 << 0,
+            WATCH_READ  = 1 << 1,
+            WATCH_WRITE = 1 << 2
+        };
+
+        enum class StopReason {
+            None,
+            User,
+            Step,
+            Breakpoint,
+            WatchRead,
+            WatchWrite
+        };
+
+        //Operand of a condition (Vx, I, DT, ST, SP or a constant)
+        struct Operand {
+            enum Kind { Register, Index, Delay, Sound, StackPointer, Constant } kind;
+            unsigned short value;
+        };
+
+        //"V3 == 0x10", "I >= 0x300", "DT != 0"
+        struct Condition {
+            Operand left;
+            std::string op;
+            Operand right;
+        };
+
+        struct Breakpoint {
+            unsigned short address;
+            bool conditional;
+            Condition condition;
+            std::string text;
+        };
+
+        struct Watchpoint {
+            unsigned short address;
+            unsigned short length;
+            unsigned char mode;             // WATCH_READ | WATCH_WRITE
+        };
+
+        unsigned char flags[0x10000]{};
+        std::vector<Breakpoint> breakpoints;
+        std::vector<Watchpoint> watchpoints;
+
+        bool paused;
+        StopReason reason;
+        unsigned short stopAddress;         // PC (breakpoint) or memory address (watchpoint)
+        int resumePC;                       // Breakpoint to step over after a resume (-1 = none)
+
+        Debugger();
+        bool armed();
+        bool addBreakpoint(unsigned short address, const std::string& condition, std::string& error);
+        void removeBreakpoint(unsigned short address);
+        void addWatchpoint(unsigned short address, unsigned short length, unsigned char mode);
+        void removeWatchpoint(size_t i);
+        void clear();
+
+        void pause(StopReason why, unsigned short address);
+        void resume(unsigned short pc);
+        std::string describeStop();
+
+        static bool parseCondition(const std::string& text, Condition& condition, std::string& error);
+        static bool test(const Condition& condition, const unsigned char v[16], unsigned short index,
+                         unsigned char delay, unsigned char sound, unsigned char sp);
+
+    private:
+        void rebuildWatchFlags();
+};
+
+#endif
@@ -0,0 +1,38 @@
+// disassembler.h
+#ifndef disassembler_h
+#define disassembler_h
+#include "chip8.h"
+#include <string>
+#include <vector>
+
+/*
+    Disassembler (CHIP-8 / SCHIP / XO-CHIP)
+
+    Lines are cached per address and stamped with the write version of the
+    memory pages the instruction covers (Chip8::pageVersion), so only
+    addresses on pages that were written since are decoded again.
+*/
+class Disassembler {
+
+    public:
+        struct Line {
+            bool valid;
+            bool xochip;                    // Decoded with XO-CHIP lengths (F000 NNNN)
+            unsigned int version;           // pageVersion of the first byte
+            unsigned int nextVersion;       // pageVersion of the last byte
+            unsigned char length;           // 2, or 4 for F000 NNNN
+            std::string text;
+        };
+
+        Disassembler();
+
+        const Line& line(Chip8& chip8, unsigned short address);
+        void clear();
+
+        static std::string decode(unsigned short opcode, unsigned short next, bool xochip, unsigned char& length);
+
+    private:
+        std::vector<Line> cache;
+};
+
+#endif
@@ -0,0 +1,45 @@
+// filewatcher.h
+#ifndef filewatcher_h
+#define filewatcher_h
+#include <string>
+#include <thread>
+#include <atomic>
+
+/*
+    File Watcher
+
+    Watches a single file from a background thread without polling
+    (inotify on Linux, change notifications on Windows). The folder is watched
+    rather than the file because assemblers usually replace the output
+    (write + rename). Bursts of events are debounced so a rebuild only
+    reports one change.
+*/
+class FileWatcher {
+
+    public:
+        static const int DEBOUNCE_MS = 100;
+
+        FileWatcher();
+        ~FileWatcher();
+
+        bool watch(const std::string& fileName);
+        void stop();
+        bool watching();
+        bool changed();
+
+    private:
+        std::string path;
+        std::thread worker;
+        std::atomic<bool> stopping;
+        std::atomic<bool> pendingChange;
+
+#ifdef _WIN32
+        void* stopEvent;                // HANDLE
+#else
+        int stopPipe[2];
+#endif
+
+        void run();
+};
+
+#endif
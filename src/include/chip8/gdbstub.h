@@ -0,0 +1,67 @@
+// gdbstub.h
+#ifndef gdbstub_h
+#define gdbstub_h
+#include "chip8.h"
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+/*
+    GDB Remote Serial Protocol Stub
+
+    A background thread accepts one debugger connection (TCP on localhost,
+    or a Unix socket) and splits the stream into packets. Packets are queued
+    and executed by the emulation thread in service(), once per frame, so
+    the core is never touched from two threads and the dispatch loop has no
+    extra checks: breakpoints go through the Debugger like the UI ones.
+
+    Registers (target.xml): V0-VF (8 bit), I, PC (16 bit), SP, DT, ST (8 bit)
+
+    Supported: ? g G p P m M Z0-Z4 z0-z4 s c D k, Ctrl-C, qSupported, qXfer target.xml
+*/
+class GdbStub {
+
+    public:
+        static const unsigned short DEFAULT_PORT = 2159;
+
+        GdbStub();
+        ~GdbStub();
+
+        bool listenTcp(unsigned short port, std::string& error);
+        bool listenUnix(const std::string& path, std::string& error);
+        void stop();
+        bool listening();
+        bool connected();
+        std::string endpoint();
+
+        //Emulation thread (frame boundary)
+        void service(Chip8& chip8);
+
+    private:
+        std::thread worker;
+        std::atomic<bool> stopping;
+        std::atomic<bool> clientConnected;
+        std::atomic<bool> attached;         // New connection, core not stopped yet
+        std::atomic<bool> interrupted;      // Ctrl-C
+        long long listenSocket;
+        long long clientSocket;
+        std::string name;
+        std::string unixPath;
+
+        std::mutex lock;
+        std::deque<std::string> commands;   // Packets for the emulation thread
+        std::deque<std::string> replies;    // Packet payloads for the client
+
+        bool waitingForStop;                // Continue sent, stop reply pending
+
+        void run();
+        void reply(const std::string& payload);
+        bool execute(Chip8& chip8, const std::string& packet, std::string& response);
+        std::string stopReply(Chip8& chip8);
+        std::string readRegisters(Chip8& chip8);
+        bool writeRegister(Chip8& chip8, unsigned int number, const std::string& hex);
+};
+
+#endif
@@ -5,6 +5,14 @@
 #include <imgui_impl_sdl2.h>
 #include <imgui_impl_sdlrenderer2.h>
 #include <SDL.h>
+#include <postprocess.h>
+#include <upscaler.h>
+#include <threadpool.h>
+
+//Packed display: bitplanes of 128 x 64 pixels, 64 per word (see Chip8::display)
+static const int DISPLAY_PLANES = 2;
+static const int DISPLAY_ROWS = 64;
+static const int DISPLAY_WORDS = 2;
 
 class Graphics {
 
@@ -13,19 +21,36 @@ class Graphics {
         SDL_Renderer* renderer;
         SDL_Texture* texture;
         SDL_Texture* gameTexture;
+        int displayWidth;               // Pixels of the texture in use (64 x 32 or 128 x 64)
+        int displayHeight;
+        Uint32 palette[1 << DISPLAY_PLANES];    // ARGB colour of each plane combination
+        bool vsync;                     // Present waits for the vertical blank
+        Upscaler upscaler;              // Scale2x/Scale3x/Scale4x/xBR
+        PostProcess effects;            // Phosphor and scanlines
+        ThreadPool pool;                // Row bands of both
+        int textureScale;               // Texels per display pixel (integer scaling with effects on)
         int SCALEX;
         int SCALEY;
         int WIDTH;
         int HEIGHT;
-        int SCREENX;
+        int SCREENX;                    // Window size of the default layout
         int SCREENY;
       
 
         Graphics();
         void init();
         void fullscreen(bool fullscreen);
-        void drawDisplay(unsigned char display[64][32]);
-        void clear(unsigned char display[64][32]);
+        void extendScreen(int width);
+        void drawDisplay(const unsigned long long display[DISPLAY_PLANES][DISPLAY_ROWS][DISPLAY_WORDS], int width, int height);
+        ImVec2 displayUV();
+        ImVec2 displaySize();
+        void setVSync(bool on);
+        void present();
+        void invalidate();
+
+    private:
+        bool dirty;                     // Settings changed: the texture needs redrawing
+        int scale();
 };
 
 #endif
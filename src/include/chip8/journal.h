@@ -0,0 +1,89 @@
+// journal.h
+#ifndef journal_h
+#define journal_h
+#include <stddef.h>
+
+/*
+    Undo Journal (Reverse Execution)
+
+    While debugging, every instruction appends a small record holding the
+    values it is about to overwrite (registers, memory bytes, the XOR delta
+    of the display rows it drew on). Stepping back pops the newest record and
+    puts the old values back.
+
+    Records live in a fixed size ring buffer; when it is full the oldest
+    records are dropped. Layout of a record in the ring:
+
+        u16 length | u8 type | [u16 pc] | entries... | u16 length
+
+    The PC is only stored when the instruction did not fall through to
+    PC + 2, so a typical record is 5-7 bytes.
+*/
+class Journal {
+
+    public:
+        static const size_t DEFAULT_CAPACITY = 8 << 20;     // 8 MB
+        static const size_t MAX_RECORD = 4096;
+
+        //Record Types
+        enum {
+            RECORD_INSTRUCTION  = 0x00,
+            RECORD_FRAME        = 0x01,     // Timers ticked (DT, ST, frameStep)
+            RECORD_HAS_PC       = 0x80      // PC before the instruction follows the type
+        };
+
+        //Entry Tags (old value follows)
+        enum {
+            ENTRY_V         = 0x00,         // 0x00-0x0F: V0-VF, u8
+            ENTRY_INDEX     = 0x10,         // u16
+            ENTRY_SP        = 0x11,         // u8
+            ENTRY_STACK     = 0x12,         // u8 slot, u16 value
+            ENTRY_DELAY     = 0x13,         // u8
+            ENTRY_SOUND     = 0x14,         // u8
+            ENTRY_HIRES     = 0x15,         // u8 (SUPER-CHIP resolution)
+            ENTRY_RPL       = 0x16,         // u8 slot, u8 value
+            ENTRY_PLANES    = 0x17,         // u8 (XO-CHIP plane mask)
+            ENTRY_MEMORY    = 0x20,         // u16 address, u8 value
+            ENTRY_DISPLAY   = 0x21          // u8 row, u8 plane * 2 + word, u64 xor mask
+        };
+
+        bool enabled;
+
+        Journal();
+        ~Journal();
+
+        void clear();
+        bool empty();
+        size_t bytes();
+        size_t records();
+
+        //Building a record
+        void begin(unsigned char type, unsigned short pc);
+        void put8(unsigned char value);
+        void put16(unsigned short value);
+        void put64(unsigned long long value);
+        void commit(bool storePC);
+        unsigned short startPC();
+
+        //Newest record (without the length fields). Returns false when empty.
+        bool pop(unsigned char* out, size_t& length);
+
+    private:
+        unsigned char* ring;
+        size_t capacity;
+        size_t head;                    // Next write position
+        size_t tail;                    // Oldest record
+        size_t used;
+        size_t count;
+
+        unsigned char record[MAX_RECORD];
+        size_t recordLength;
+        unsigned short recordPC;
+
+        void write(const unsigned char* data, size_t length);
+        void read(size_t at, unsigned char* data, size_t length);
+        unsigned short read16(size_t at);
+        void dropOldest();
+};
+
+#endif
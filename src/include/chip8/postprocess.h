@@ -0,0 +1,45 @@
+// postprocess.h
+#ifndef postprocess_h
+#define postprocess_h
+#include <SDL.h>
+#include <vector>
+#include <atomic>
+#include <threadpool.h>
+
+/*
+    Post Process
+
+    CPU effects between the (upscaled) display and the game texture, so they run
+    without shaders. Phosphor keeps an intensity per colour channel that
+    decays every emulated frame and never drops below the current frame, so
+    sprites erased and redrawn in the next frame stop flickering. The result
+    is scaled up by an integer factor and every last row of a scaled pixel
+    row can be darkened (scanlines).
+
+    The per-pixel kernels have SSE2 and AVX2 versions picked at run time,
+    with a scalar fallback for other hosts. Rows are split in bands over the
+    thread pool.
+*/
+class PostProcess {
+
+    public:
+        static const int MAX_WIDTH = 512;   // Largest frame (upscaled display)
+        static const int MAX_HEIGHT = 256;
+
+        int decay;                          // Phosphor intensity kept per frame (of 256), 0: off
+        bool scanlines;
+
+        PostProcess();
+        bool enabled();
+        bool fading();
+        void process(const Uint32* frame, int stride, int width, int height, int scale, Uint32* out, int pitch, ThreadPool& pool);
+        static const char* kernels();
+
+    private:
+        std::vector<Uint32> phosphor;       // MAX_WIDTH x MAX_HEIGHT, ARGB
+        std::atomic<bool> phosphorFading;   // Some pixel is still above the frame
+        int phosphorWidth;                  // Frame size the phosphor follows
+        int phosphorHeight;
+};
+
+#endif
@@ -0,0 +1,52 @@
+// profiler.h
+#ifndef profiler_h
+#define profiler_h
+#include <stddef.h>
+#include <vector>
+
+/*
+    Execution Profiler
+
+    Flat counters per address (instructions executed at each PC, data reads
+    and writes) and per opcode class. They are only updated by the
+    HOOK_PROFILE dispatch loop, so runs without the profiler never touch
+    them.
+*/
+class Profiler {
+
+    public:
+        static const unsigned int ADDRESSES = 0x10000;
+
+        //Opcode Classes
+        enum {
+            OP_CLS, OP_RET, OP_SYS, OP_JP, OP_CALL, OP_SE_BYTE, OP_SNE_BYTE, OP_SE_REG,
+            OP_LD_BYTE, OP_ADD_BYTE, OP_ALU, OP_SNE_REG, OP_LD_I, OP_JP_V0, OP_RND, OP_DRW,
+            OP_SKP, OP_LD_DT_READ, OP_LD_KEY, OP_LD_DT, OP_LD_ST, OP_ADD_I, OP_LD_FONT, OP_BCD,
+            OP_STORE, OP_LOAD, OP_AUDIO, OP_OTHER,
+            OP_CLASSES
+        };
+
+        struct HotAddress {
+            unsigned short address;
+            unsigned int count;
+        };
+
+        bool enabled;
+        unsigned int* executions;           // Per PC
+        unsigned int* reads;                // Per data address
+        unsigned int* writes;               // Per data address
+        unsigned long long classCount[OP_CLASSES];
+        unsigned long long total;
+
+        Profiler();
+        ~Profiler();
+
+        void enable(bool on);
+        void reset();
+        void hottest(const unsigned int* counts, size_t n, std::vector<HotAddress>& out);
+
+        static int opcodeClass(unsigned short opcode);
+        static const char* className(int opClass);
+};
+
+#endif
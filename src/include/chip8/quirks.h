@@ -0,0 +1,49 @@
+// quirks.h
+#ifndef quirks_h
+#define quirks_h
+
+/*
+    Platforms and Quirks
+
+    The variants the emulator runs and the behaviour differences between
+    interpreters, as flags and as bits. Nothing here depends on SDL, so
+    tools/romdb_gen.cpp writes the ROM database table with the same values.
+*/
+
+//Supported Variants
+enum class Platform {
+    CHIP8,
+    SCHIP,
+    XOCHIP
+};
+
+//Behaviour differences between interpreters (names follow the chip-8-database)
+struct Quirks {
+    bool shift;                     // 8XY6/8XYE shift VX in place instead of VY
+    bool memoryIncrementByX;        // FX55/FX65 leave I at I + X
+    bool memoryLeaveIUnchanged;     // FX55/FX65 leave I unchanged
+    bool wrap;                      // Sprites wrap around instead of clipping
+    bool jump;                      // BNNN behaves as BXNN (XNN + VX)
+    bool vblank;                    // DXYN waits for the next 60 Hz tick
+    bool logic;                     // 8XY1/8XY2/8XY3 reset VF
+};
+
+//Quirks as bits (ROM database records, compiled quirk profiles)
+enum {
+    QUIRK_SHIFT             = 1 << 0,
+    QUIRK_MEMORY_INCREMENT  = 1 << 1,
+    QUIRK_MEMORY_LEAVE_I    = 1 << 2,
+    QUIRK_WRAP              = 1 << 3,
+    QUIRK_JUMP              = 1 << 4,
+    QUIRK_VBLANK            = 1 << 5,
+    QUIRK_LOGIC             = 1 << 6,
+    QUIRKS_DYNAMIC          = 1 << 7        // Not a quirk: read Chip8::quirks at run time
+};
+
+//Quirk sets with their own interpreter (platform defaults, original COSMAC VIP)
+static const unsigned int QUIRKS_CHIP8 = QUIRK_SHIFT | QUIRK_MEMORY_LEAVE_I;
+static const unsigned int QUIRKS_SCHIP = QUIRK_SHIFT | QUIRK_MEMORY_LEAVE_I | QUIRK_JUMP;
+static const unsigned int QUIRKS_XOCHIP = QUIRK_WRAP;
+static const unsigned int QUIRKS_VIP = QUIRK_VBLANK | QUIRK_LOGIC;
+
+#endif
@@ -0,0 +1,93 @@
+// recorder.h
+#ifndef recorder_h
+#define recorder_h
+#include "audio.h"
+#include "recordfile.h"
+#include <SDL.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+/*
+    Recorder (Gameplay Video)
+
+    Captures the native display, palette and audio state changes of every
+    emulated frame into a .c8rec file (see recordfile.h), lossless. The
+    emulation thread only copies the frame into a preallocated ring slot;
+    a background thread takes the slots, codes each display as the XOR with
+    the previous one plus run-length coding (a static screen costs a few
+    bytes) and writes the records. When the encoder falls a whole ring
+    behind, frames are dropped rather than stalling the emulation.
+
+    chip8-record exports recordings to Y4M video and WAV audio.
+*/
+class Recorder {
+
+    public:
+        static const int PLANES = 2;            // Packed display layout (see Chip8::display)
+        static const int ROWS = 64;
+        static const int WORDS = 2;
+        static const int SLOTS = 128;           // Frames between emulation and encoder (~2 s)
+        static const int MAX_EVENTS = 16;       // Audio changes kept per frame (the last ones)
+        static const int KEYFRAME_INTERVAL = 600;
+        static const int FRAME_SAMPLES = Audio::SAMPLE_RATE / 60;
+
+        Recorder();
+        ~Recorder();
+
+        bool open(const std::string& path, Audio& audio, std::string& error);
+        void close();
+        bool recording();
+        unsigned long long frames();
+        unsigned long long dropped();
+        unsigned long long bytes();
+        std::string fileName();
+
+        //Emulation thread, once per completed frame
+        void capture(unsigned long long frame, const unsigned long long display[PLANES][ROWS][WORDS], bool hires,
+                     const Uint32 palette[1 << PLANES], Audio& audio);
+
+    private:
+        struct Slot {
+            unsigned long long frame;
+            bool hires;
+            int events;
+            Uint32 palette[1 << PLANES];
+            unsigned long long display[PLANES][ROWS][WORDS];
+            RecordEvent audio[MAX_EVENTS];
+        };
+
+        std::string path;
+        FILE* file;
+        std::thread encoder;
+        std::atomic<bool> running;
+
+        //Ring (emulation writes head, encoder writes tail)
+        std::vector<Slot> slots;
+        std::atomic<unsigned int> head;
+        std::atomic<unsigned int> tail;
+        std::atomic<unsigned long long> written;
+        std::atomic<unsigned long long> lost;
+        std::atomic<unsigned long long> size;
+
+        //Emulation side
+        unsigned int audioRead;                 // Audio::historyCount already captured
+        bool started;                           // First frame captured
+        Audio::State startState;                // Audio when the recording started
+
+        //Encoder side
+        unsigned long long previous[PLANES][ROWS][WORDS];
+        bool previousHires;
+        Uint32 previousPalette[1 << PLANES];
+        unsigned long long lastKey;
+        std::vector<unsigned char> raw;
+        std::vector<unsigned char> coded;
+
+        void run();
+        void encode(const Slot& slot);
+        static void toEvent(const Audio::State& state, unsigned short offset, RecordEvent& event);
+};
+
+#endif
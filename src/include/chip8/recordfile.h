@@ -0,0 +1,64 @@
+// recordfile.h
+#ifndef recordfile_h
+#define recordfile_h
+
+/*
+    Recording File Format (.c8rec)
+
+    A 16 byte header followed by one record per emulated frame, little
+    endian. Each record holds the display as the XOR with the previous
+    frame (keyframes: with a blank one), packed bytes of the bitplanes
+    run-length coded, and the audio state changes of the frame. Audio is
+    kept as the XO-CHIP state (pattern, pitch, playing), so playback is
+    synthesized again bit exact.
+
+    Frame record:
+        RecordFrame
+        Uint32 palette[4]               if RECORD_PALETTE
+        videoBytes of coded display
+        RecordEvent x events
+
+    Display bytes (before coding): plane 0 then plane 1, each height rows of
+    width / 8 bytes, the leftmost pixel in the high bit. Coding: a control
+    byte c < 128 is followed by c + 1 literal bytes, c >= 128 by one byte
+    repeated c - 126 times.
+*/
+
+#define RECORD_MAGIC "C8RC"
+static const unsigned short RECORD_VERSION = 1;
+
+struct RecordHeader {
+    char magic[4];                  // "C8RC"
+    unsigned short version;
+    unsigned short fps;             // Emulated frames per second (60)
+    unsigned int sampleRate;        // Audio samples per second
+    unsigned int frameSamples;      // Audio samples per frame
+};
+
+//Frame Flags
+enum {
+    RECORD_KEY = 1 << 0,            // Coded against a blank display
+    RECORD_HIRES = 1 << 1,          // 128 x 64 (else 64 x 32)
+    RECORD_PALETTE = 1 << 2         // Palette follows (first frame and on change)
+};
+
+struct RecordFrame {
+    unsigned int frame;             // 60 Hz frame (gaps: frames dropped while recording)
+    unsigned short videoBytes;
+    unsigned char flags;
+    unsigned char events;
+};
+
+//Audio state from offset samples into the frame on
+struct RecordEvent {
+    unsigned short offset;
+    unsigned char pitch;
+    unsigned char playing;
+    unsigned char pattern[16];
+};
+
+static_assert(sizeof(RecordHeader) == 16, "RecordHeader must be 16 bytes");
+static_assert(sizeof(RecordFrame) == 8, "RecordFrame must be 8 bytes");
+static_assert(sizeof(RecordEvent) == 20, "RecordEvent must be 20 bytes");
+
+#endif
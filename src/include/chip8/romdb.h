@@ -0,0 +1,34 @@
+// romdb.h
+#ifndef romdb_h
+#define romdb_h
+#include "chip8.h"
+
+/*
+    ROM Database
+
+    Platform, quirks and speed for known ROMs, keyed by the SHA-1 of the ROM
+    (same keys as the community chip-8-database). The table is generated by
+    build.sh (tools/romdb_gen.cpp) into romdb_table.h as an open-addressed
+    hash table, so a lookup is a couple of probes and nothing is parsed at
+    startup.
+*/
+
+struct RomDBRecord {
+    unsigned char sha1[20];
+    unsigned char platform;         // Platform
+    unsigned char quirks;           // QUIRK_* bits (quirks.h)
+    unsigned short ipf;             // Instructions per Frame (tickrate)
+    const char* title;
+};
+
+struct RomProfile {
+    Platform platform;
+    Quirks quirks;
+    unsigned short ipf;
+    const char* title;
+};
+
+bool romdbLookup(const unsigned char sha1[20], RomProfile& profile);
+unsigned int romdbSize();
+
+#endif
@@ -0,0 +1,59 @@
+// romlibrary.h
+#ifndef romlibrary_h
+#define romlibrary_h
+#include "chip8.h"
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+struct RomEntry {
+    std::string path;
+    std::string title;
+    unsigned long long size;
+    long long mtime;
+    unsigned char sha1[20];
+    Platform platform;
+    bool hashed;
+};
+
+/*
+    ROM Library
+
+    Keeps a persistent index of the ROM folder (.romindex inside it) so
+    startup does not rescan and rehash tens of thousands of files. A refresh
+    runs on a background thread: files whose size and mtime did not change
+    keep their cached entry, new or modified files get hashed.
+*/
+class RomLibrary {
+
+    public:
+        RomLibrary();
+        ~RomLibrary();
+
+        void open(const std::filesystem::path& root);
+        void refresh();
+        bool busy();
+        unsigned int generation();
+        void snapshot(std::vector<RomEntry>& out);
+
+    private:
+        std::filesystem::path root;
+        std::filesystem::path indexPath;
+        std::vector<RomEntry> entries;
+        std::mutex mutex;
+        std::thread worker;
+        std::atomic<bool> running;
+        std::atomic<bool> stop;
+        std::atomic<unsigned int> gen;
+
+        void scan();
+        bool loadIndex();
+        bool saveIndex();
+};
+
+Platform detectPlatform(const std::filesystem::path& path, unsigned long long size);
+
+#endif
@@ -0,0 +1,27 @@
+// sha1.h
+#ifndef sha1_h
+#define sha1_h
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+//SHA-1 (same digest the community chip-8-database uses to identify ROMs)
+class SHA1 {
+
+    public:
+        SHA1();
+        void update(const void* data, size_t length);
+        void final(unsigned char digest[20]);
+
+        static std::string toHex(const unsigned char digest[20]);
+        static bool hashFile(const std::string& fileName, unsigned char digest[20]);
+
+    private:
+        uint32_t state[5];
+        uint64_t count;             // Bytes hashed so far
+        unsigned char buffer[64];
+
+        void transform(const unsigned char block[64]);
+};
+
+#endif
@@ -0,0 +1,48 @@
+// threadpool.h
+#ifndef threadpool_h
+#define threadpool_h
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/*
+    Thread Pool
+
+    A few worker threads that split per-row image work into bands. The
+    caller takes bands too and bands() returns once all of them are done.
+    Workers are only started by the first job, so headless instances
+    (conformance runs, benchmarks) never create threads.
+*/
+class ThreadPool {
+
+    public:
+        static const int MAX_WORKERS = 3;
+
+        ThreadPool();
+        ~ThreadPool();
+
+        void bands(int rows, const std::function<void(int first, int last)>& work);
+
+    private:
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        bool started;
+        bool stopping;
+
+        //Current job
+        const std::function<void(int, int)>* job;
+        int jobRows;
+        int bandCount;
+        int nextBand;
+        int pending;                    // Bands not finished yet
+        unsigned long long generation;  // Bumped by every job
+
+        void start();
+        void runBands();
+};
+
+#endif
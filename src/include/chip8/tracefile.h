@@ -0,0 +1,48 @@
+// tracefile.h
+#ifndef tracefile_h
+#define tracefile_h
+
+/*
+    Trace File Format (.c8trace)
+
+    A 16 byte header followed by fixed size records, little endian, so a
+    reader can seek to record N directly and stream files of any size.
+    The header counts the records; the writer updates it whenever it moves
+    to the next mapped window and on close, and readers stop there (a trace
+    that was not closed can end in zero filled space).
+*/
+
+#define TRACE_MAGIC "C8TR"
+static const unsigned short TRACE_VERSION = 1;
+
+struct TraceHeader {
+    char magic[4];                  // "C8TR"
+    unsigned short version;
+    unsigned short recordSize;      // sizeof(TraceRecord)
+    unsigned long long records;     // Records written (readers ignore what follows)
+};
+
+//Record Flags
+enum {
+    TRACE_BRANCH = 1 << 0           // Next PC is not PC + 2 (jump, call, return, skip)
+};
+
+struct TraceRecord {
+    unsigned int frame;             // 60 Hz frame
+    unsigned short step;            // Instruction inside the frame
+    unsigned short pc;
+    unsigned short opcode;
+    unsigned short nextPC;
+    unsigned short index;           // I before the instruction
+    unsigned char vx;               // VX before
+    unsigned char vy;               // VY before
+    unsigned char result;           // VX after
+    unsigned char vf;               // VF after
+    unsigned char sp;
+    unsigned char flags;
+};
+
+static_assert(sizeof(TraceHeader) == 16, "TraceHeader must be 16 bytes");
+static_assert(sizeof(TraceRecord) == 20, "TraceRecord must be 20 bytes");
+
+#endif
@@ -0,0 +1,73 @@
+// tracer.h
+#ifndef tracer_h
+#define tracer_h
+#include "debugger.h"
+#include "tracefile.h"
+#include <string>
+#include <vector>
+
+/*
+    Tracer (Conditional Instruction Tracing)
+
+    Trace points select instructions by PC range, opcode mask and an
+    optional register condition (same syntax as breakpoint conditions).
+    With no trace points every instruction is traced. Matching
+    instructions are written as TraceRecords straight into a memory
+    mapped file, one window at a time, so tracing costs a copy per record
+    and the file can grow to any size.
+*/
+class Tracer {
+
+    public:
+        static const unsigned int WINDOW = 16 << 20;        // Mapped at a time (multiple of the allocation granularity)
+
+        struct TracePoint {
+            unsigned short start;
+            unsigned short end;
+            unsigned short mask;            // Opcode & mask == match
+            unsigned short match;
+            bool conditional;
+            Debugger::Condition condition;
+            std::string text;
+        };
+
+        std::vector<TracePoint> points;
+
+        Tracer();
+        ~Tracer();
+
+        bool open(const std::string& path, std::string& error);
+        void close();
+        bool recording();
+        unsigned long long records();
+        std::string fileName();
+
+        bool addPoint(unsigned short start, unsigned short end, unsigned short mask, unsigned short match,
+                      const std::string& condition, std::string& error);
+        void removePoint(size_t i);
+
+        bool matches(unsigned short pc, unsigned short opcode, const unsigned char v[16], unsigned short index,
+                     unsigned char delay, unsigned char sound, unsigned char sp);
+        void write(const TraceRecord& record);
+
+    private:
+        std::string path;
+        unsigned char* window;              // Mapped view
+        unsigned long long windowOffset;    // File offset of the view
+        unsigned int used;                  // Bytes written in the view
+        unsigned long long count;
+
+#ifdef _WIN32
+        void* file;                         // HANDLE
+        void* mapping;                      // HANDLE
+#else
+        int file;
+#endif
+
+        bool mapWindow(unsigned long long offset);
+        void unmapWindow();
+        void writeCount();
+        void put(const void* data, unsigned int length);
+};
+
+#endif
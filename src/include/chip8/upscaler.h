@@ -0,0 +1,72 @@
+// upscaler.h
+#ifndef upscaler_h
+#define upscaler_h
+#include <SDL.h>
+#include <vector>
+#include <threadpool.h>
+
+/*
+    Upscaler
+
+    Pixel-art scalers run on the packed display: every rule is evaluated
+    with bitwise operations on whole 64-pixel words of each bitplane, and
+    the sub-pixel columns are interleaved back into packed rows. Only the
+    last step expands the palette into colours.
+
+        Scale2x     AdvMAME2x rules (EPX gives the same result)
+        Scale3x     AdvMAME3x rules
+        Scale4x     Scale2x applied twice
+        xBR         2xBR edge detection on a 5x5 neighbourhood; the new
+                    pixels take a neighbour's colour (the palette is kept)
+
+    Rows are split in bands over the thread pool. The result is kept while
+    the display, palette and mode stay the same.
+*/
+class Upscaler {
+
+    public:
+        static const int PLANES = 2;        // Packed display layout (see Chip8::display)
+        static const int ROWS = 64;
+        static const int WORDS = 2;
+        static const int MAX_FACTOR = 4;
+        static const int STRIDE = WORDS * 64 * MAX_FACTOR;     // Pixels per row of frame()
+
+        enum Mode { NONE, SCALE2X, SCALE3X, SCALE4X, XBR, MODES };
+
+        int mode;
+
+        Upscaler();
+        int factor();
+        static const char* name(int mode);
+        bool process(const unsigned long long display[PLANES][ROWS][WORDS], int width, int height,
+            const Uint32 palette[1 << PLANES], ThreadPool& pool);
+        const Uint32* frame();
+
+        //Packed bitplanes of any size (rows of whole 64-pixel words)
+        struct Packed {
+            int width = 0;
+            int height = 0;
+            int words = 0;
+            std::vector<unsigned long long> bits;      // [plane][row][word]
+
+            void resize(int width, int height);
+            unsigned long long* row(int plane, int y);
+            const unsigned long long* row(int plane, int y) const;
+        };
+
+    private:
+        Packed source;
+        Packed doubled;                     // Scale2x result (first pass of Scale4x)
+        Packed scaled;
+        std::vector<Uint32> output;         // STRIDE x ROWS * MAX_FACTOR colours
+
+        //Input of the frame in output
+        bool valid;
+        unsigned long long cached[PLANES][ROWS][WORDS];
+        int cachedWidth;
+        int cachedHeight;
+        int cachedMode;
+        Uint32 cachedPalette[1 << PLANES];
+};
+
+#endif
@@ -1,7 +1,14 @@
 #include <iostream>
 #include <fstream>
 #include <chip8.h>
+#include <romlibrary.h>
+#include <sha1.h>
+#include <filewatcher.h>
+#include <disassembler.h>
+#include <gdbstub.h>
 #include <filesystem>
+#include <algorithm>
+#include <cmath>
 #include <windows.h> // WinApi header 
 
 
@@ -74,6 +81,119 @@ Z X C V
 
 */
 
+//Call tree node (and its callees when expanded) for the Profiler window
+static void drawCallNode(CallGraph& graph, int node, unsigned long long rootTotal) {
+
+    unsigned long long total = graph.total(node);
+    CallGraph::Node& entry = graph.nodes[node];
+    ImGuiTreeNodeFlags flags = entry.firstChild < 0 ? ImGuiTreeNodeFlags_Leaf : 0;
+    if (node == graph.current) {
+        flags |= ImGuiTreeNodeFlags_Selected;
+    }
+
+    bool open = ImGui::TreeNodeEx((void*)(intptr_t)node, flags, "%s  %.1f%% (self %llu, calls %llu)", graph.name(node).c_str(),
+        rootTotal ? 100.0 * total / rootTotal : 0.0, entry.self, entry.calls);
+    if (open) {
+        for (int c = entry.firstChild; c >= 0; c = graph.nodes[c].nextSibling)
+        {
+            drawCallNode(graph, c, rootTotal);
+        }
+        ImGui::TreePop();
+    }
+}
+
+
+//Host time spent in each stage of the main loop (Frame Timing overlay)
+struct FrameTiming {
+    enum Stage { INPUT, EMULATE, UPLOAD, UI, PRESENT, STAGES };
+    static const int HISTORY = 120;
+
+    Uint64 start = 0;                   // Performance counter at the last mark
+    Uint64 lastCommit = 0;
+    double current[STAGES]{};           // ms of the frame being measured
+    double average[STAGES]{};           // Smoothed ms per stage
+    double interval = 0;                // Smoothed ms between committed frames
+    float history[HISTORY]{};           // ms of work of the last frames
+    int next = 0;
+
+    void begin() {
+        start = SDL_GetPerformanceCounter();
+        for (int i = 0; i < STAGES; i++)
+        {
+            current[i] = 0;
+        }
+    }
+
+    void mark(Stage stage) {
+        Uint64 now = SDL_GetPerformanceCounter();
+        current[stage] += (now - start) * 1000.0 / SDL_GetPerformanceFrequency();
+        start = now;
+    }
+
+    void commit() {
+        double total = 0;
+        for (int i = 0; i < STAGES; i++)
+        {
+            average[i] = average[i] * 0.9 + current[i] * 0.1;
+            total += current[i];
+        }
+        if (lastCommit != 0) {
+            interval = interval * 0.9 + (start - lastCommit) * 1000.0 / SDL_GetPerformanceFrequency() * 0.1;
+        }
+        lastCommit = start;
+        history[next] = (float)total;
+        next = (next + 1) % HISTORY;
+    }
+
+    static const char* name(int stage) {
+        static const char* names[STAGES] = { "Input", "Emulate", "Upload", "UI", "Present" };
+        return names[stage];
+    }
+};
+
+//Frame Timing overlay (F2)
+static void drawFrameTiming(FrameTiming& timing, Graphics& graphics) {
+
+    ImGui::SetNextWindowPos(ImVec2(10, 30), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowBgAlpha(0.8f);
+    ImGui::Begin("Frame Timing", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings);
+    double total = 0;
+    for (int i = 0; i < FrameTiming::STAGES; i++)
+    {
+        ImGui::Text("%-8s %6.3f ms", FrameTiming::name(i), timing.average[i]);
+        total += timing.average[i];
+    }
+    ImGui::Separator();
+    ImGui::Text("%-8s %6.3f ms", "Work", total);
+    ImGui::Text("%-8s %6.3f ms (%.0f fps)", "Frame", timing.interval, timing.interval > 0 ? 1000.0 / timing.interval : 0.0);
+    ImGui::PlotLines("##work", timing.history, FrameTiming::HISTORY, timing.next, nullptr, 0.0f, 16.0f, ImVec2(200, 40));
+    bool vsync = graphics.vsync;
+    if (ImGui::Checkbox("VSync", &vsync)) {
+        graphics.setVSync(vsync);
+    }
+    ImGui::End();
+}
+
+//Start/stop recording gameplay to recordings/<rom>.c8rec (export with chip8-record)
+static void toggleRecording(Chip8& chip8) {
+
+    if (chip8.recorder.recording()) {
+        chip8.recorder.close();
+        chip8.pushLog("Recording saved: " + chip8.recorder.fileName() + " (" + to_string(chip8.recorder.frames()) + " frames, " +
+            to_string(chip8.recorder.dropped()) + " dropped)");
+        return;
+    }
+    fs::path recordings = fs::current_path() / "../recordings";
+    std::error_code ec;
+    fs::create_directories(recordings, ec);
+    std::string stem = chip8.romPath.empty() ? "chip8" : fs::path(chip8.romPath).stem().string();
+    std::string error;
+    if (chip8.recorder.open((recordings / (stem + ".c8rec")).string(), chip8.audio, error)) {
+        chip8.pushLog("Recording: " + chip8.recorder.fileName());
+    } else {
+        chip8.pushLog("Recording: " + error);
+    }
+}
 
 int main(int argv, char** args)
 {   
@@ -87,33 +207,78 @@ int main(int argv, char** args)
     //New Chip8 Instance (Reset Values + Init Graphics)
     Chip8 chip8 = Chip8();
 
-    //Map of ROMS    
-    std::map<std::string, std::string> roms;
-
-    //Get Current Directory
+    //ROM Library (cached index, refreshed in the background)
     std::filesystem::path romsPath = std::filesystem::current_path() / "../roms";
-    std::filesystem::path resolvedPath = std::filesystem::absolute(romsPath);
-
-
-    for (const auto & entry : fs::directory_iterator(resolvedPath))
-    {   
-        //Ignore .gitignore
-        if(entry.path().filename() == ".gitignore")
-        {
-            continue;
-        }
-
-        //Add to Map
-        roms[entry.path().filename().string()] = entry.path().string();
-    }
+    RomLibrary library;
+    library.open(std::filesystem::absolute(romsPath));
+
+    //ROM Picker State
+    std::vector<RomEntry> roms;
+    std::vector<int> filteredRoms;
+    char romFilter[128] = "";
+    std::string appliedFilter;
+    unsigned int romsGeneration = (unsigned int)-1;
+    Uint32 romsSnapshotTime = 0;
+    const Uint32 ROMS_REFRESH_MS = 500;     // Snapshot interval while indexing (each one copies the whole index)
+
+    //Hot Reload (reload the ROM when the file changes on disk)
+    FileWatcher romWatcher;
+    bool hotReload = false;
+    bool hotReloadKeepRegisters = false;
+
+    //Debugger Inputs
+    char breakAddress[8] = "";
+    char breakCondition[64] = "";
+    char watchAddress[8] = "";
+    int watchLength = 1;
+    bool watchRead = false;
+    bool watchWrite = true;
+    std::string debuggerError;
+    bool recordHistory = true;
+
+    //Trace Point Inputs
+    char traceStart[8] = "";
+    char traceEnd[8] = "";
+    char traceMask[8] = "";
+    char traceMatch[8] = "";
+    char traceCondition[64] = "";
+    std::string traceError;
+
+    //Profiler View
+    bool showProfiler = false;
+    int profilerView = 0;                   // 0 Executions, 1 Reads, 2 Writes
+    std::vector<Profiler::HotAddress> hotAddresses;
+    unsigned long long hotRefresh = 0;
+    bool recordCalls = false;
+    int callSampleInterval = 1;
+
+    //Disassembly View
+    Disassembler disassembler;
+    bool showDisassembly = false;
+    bool followPC = true;
+    unsigned short followedPC = 0xFFFF;
+
+    //Hex Editor
+    bool showHexEditor = false;
+    int editAddress = -1;                   // Byte being edited
+    char editValue[3] = "";
+    char gotoAddress[8] = "";
+    int scrollToRow = -1;
+
+    //GDB Remote Debugging
+    GdbStub gdbStub;
+    int gdbPort = GdbStub::DEFAULT_PORT;
 
     /**
      * 
      * outer loop:
 
-        1 DEcrement timers and render display
-        2 execute inner loop
-        3 goto 1
+        1 input (events, hot reload)
+        2 execute inner loop, then decrement timers
+        3 upload the display to the game texture
+        4 build the UI
+        5 present (once)
+        6 sleep until the next frame, goto 1
 
         inner loop:
 
@@ -123,19 +288,39 @@ int main(int argv, char** args)
 
     */
 
+    //Low-power idle: frames are paced by SDL_WaitEventTimeout, so input wakes the
+    //loop at once, and nothing is emulated or rendered while there is nothing to do
+    const Uint32 FRAME_MS = 16;
+    const Uint32 IDLE_WAIT_MS = 250;        // Longest sleep (paused, no ROM or a static screen)
+    Uint32 nextFrame = SDL_GetTicks();
+    Uint32 lastRender = 0;
+    int redrawFrames = 2;                   // UI frames still to render (ImGui settles a frame after input)
+    FrameTiming timing;
+    bool showTiming = false;
+    unsigned int seenLogs = chip8.logCount; // Background changes already drawn
+    unsigned int seenGeneration = library.generation();
+    bool seenBusy = library.busy();
+
     bool quit = false;
     while (!quit)
     {
+        timing.begin();
+
+        //1. Input
 
         //Wait for Key Press
         SDL_Event event;
         while (SDL_PollEvent(&event))
         {
             ImGui_ImplSDL2_ProcessEvent(&event); // Forward your event to backend
+            redrawFrames = 3;
             switch (event.type) 
             {
                 case SDL_KEYDOWN:
-                    chip8.pressKey(event.key.keysym.scancode);
+                    //Typing in a text box (ROM search) is not game input
+                    if (!ImGui::GetIO().WantTextInput) {
+                        chip8.pressKey(event.key.keysym.scancode);
+                    }
                     if(event.key.keysym.scancode == SDL_SCANCODE_F1)
                     {
                         if (chip8.debugMode)
@@ -146,6 +331,14 @@ int main(int argv, char** args)
                             chip8.graphics.fullscreen(false);
                             chip8.debugMode = true;
                         }
+                        //New game window size: new integer scale
+                        chip8.drawFlag = true;
+                    }
+                    if (event.key.keysym.scancode == SDL_SCANCODE_F2) {
+                        showTiming = !showTiming;
+                    }
+                    if (event.key.keysym.scancode == SDL_SCANCODE_F3) {
+                        toggleRecording(chip8);
                     }
                     break;
                 case SDL_KEYUP:
@@ -159,148 +352,850 @@ int main(int argv, char** args)
         }
 
 
-        //Update the texture
-        SDL_RenderPresent(chip8.graphics.renderer);
+        //Hot Reload at the frame boundary
+        if (romWatcher.changed()) {
+            ROMResult result = chip8.reloadROM(hotReloadKeepRegisters);
+            if (result.status == ROMStatus::OK) {
+                chip8.pushLog("Reloaded ROM: " + chip8.romPath);
+            } else {
+                chip8.pushLog("Failed to reload ROM: " + result.message);
+            }
+            redrawFrames = 1;
+        }
+        timing.mark(FrameTiming::INPUT);
+
+        //2. Emulate
 
-        // Update ImGui frame
-        ImGui_ImplSDLRenderer2_NewFrame();
-        ImGui_ImplSDL2_NewFrame();
-        ImGui::NewFrame();
+        //Undo Journal only records while debugging
+        bool journalOn = chip8.debugMode && recordHistory;
+        if (chip8.journal.enabled && !journalOn) {
+            chip8.journal.clear();
+        }
+        chip8.journal.enabled = journalOn;
 
-        
+        //Profiler counts only while its window is open
+        chip8.profiler.enable(chip8.debugMode && showProfiler);
+        chip8.callGraph.enabled = chip8.debugMode && showProfiler && recordCalls;
 
-        //Game Display
-        ImGui::SetNextWindowSize(ImVec2(chip8.graphics.WIDTH + 20, chip8.graphics.HEIGHT + 40));
-        ImGui::SetNextWindowPos(ImVec2(0, 0));
-        ImGui::Begin("Game", nullptr, chip8.debugMode ? 0 : ImGuiWindowFlags_NoTitleBar);
-        ImGui::Image((ImTextureID)chip8.graphics.texture, ImVec2(chip8.graphics.WIDTH, chip8.graphics.HEIGHT));
-        ImGui::End();
+        //GDB packets run here, between frames
+        gdbStub.service(chip8);
 
-        if(chip8.debugMode) {
+        //Nothing to emulate while the debugger holds the program or no ROM is loaded
+        //(GDB may have written one to memory)
+        bool running = !chip8.debugger.paused && (!chip8.romPath.empty() || gdbStub.connected());
 
-            //--------------------------------------------//
+        //Emulator Loop (Frame), every 16 ms
+        Uint32 now = SDL_GetTicks();
+        bool frameRan = running && (Sint32)(now - nextFrame) >= 0;
+        if (frameRan) {
+            //Don't race to catch up after a pause or a stall
+            nextFrame = (Sint32)(now - nextFrame) > (Sint32)(4 * FRAME_MS) ? now + FRAME_MS : nextFrame + FRAME_MS;
 
-            //Console Debug
-            ImGui::SetNextWindowSize(ImVec2(660, 360));
-            ImGui::SetNextWindowPos(ImVec2(0, 361));
-            ImGui::Begin("Debug Console", nullptr, ImGuiWindowFlags_HorizontalScrollbar);
-            //Print Console Stack
-            for (int i = 45; i >= 0; i--)
-            {
-                ImGui::Text(chip8.console[i].c_str());
+            bool frameDone = chip8.cycle();
+
+            //Hex Editor highlights what this frame stored
+            chip8.latchWrites();
+            if (chip8.debugger.paused) {
+                chip8.pushLog(chip8.debugger.describeStop());
+                redrawFrames = 1;
             }
-            ImGui::End();
 
-            //--------------------------------------------//
+            //Registers and timers on the debug windows change every frame
+            if (chip8.debugMode) {
+                redrawFrames = 1;
+            }
 
-            //Emulator Memory
-            ImGui::SetNextWindowSize(ImVec2(282, 360));
-            ImGui::SetNextWindowPos(ImVec2(661, 0));
-            ImGui::Begin("Memory");
-            ImGui::Columns(2);
-            //Column for Registers
-            ImGui::Text("Registers");
-            for (int i = 0; i < 16; i++)
-            {
-                ImGui::Text("V%X: %X", i, chip8.v[i]);
+            //Delay + Sound Timers (60 Hz, once the frame's instructions have all run)
+            if (frameDone) {
+                chip8.updateTimers();
             }
-            ImGui::NextColumn();
-            //Column for Timers
-            ImGui::Text("Counters/Timers");
-            ImGui::Text("PC: %X", chip8.pc);
-            ImGui::Text("I: %X", chip8.index);
-            ImGui::Text("SP: %X", chip8.sp);
-            ImGui::Text("Last Opcode: %X", chip8.lastOpcode);
-            ImGui::Text("Draw Flag: %s", chip8.drawFlag ? "True" : "False");
-            ImGui::Text("Pressed Key: %X", chip8.pressedKey);
-            ImGui::Text("Delay Timer: %X", chip8.delay_timer);
-            ImGui::Text("Sound Timer: %X", chip8.sound_timer);
-            ImGui::End();
+        }
+        timing.mark(FrameTiming::EMULATE);
+
+        //3. Upload the display to the game texture (every frame while the phosphor fades)
+        if(chip8.drawFlag || (frameRan && chip8.graphics.effects.fading()))
+        {
+            chip8.drawFlag = false;
+            chip8.updateDisplay();
+            redrawFrames = 1;
+        }
+        timing.mark(FrameTiming::UPLOAD);
+
+        //Changes made off the input path: log lines (GDB stub, file watcher) and
+        //ROM library indexing progress
+        if (chip8.logCount != seenLogs || library.generation() != seenGeneration || library.busy() != seenBusy) {
+            seenLogs = chip8.logCount;
+            seenGeneration = library.generation();
+            seenBusy = library.busy();
+            redrawFrames = redrawFrames > 0 ? redrawFrames : 1;
+        }
+
+        //4. Build the UI, only when something changed (the debug windows refresh a
+        //few times a second on their own while idle)
+        now = SDL_GetTicks();
+        bool render = redrawFrames > 0 || (chip8.debugMode && now - lastRender >= IDLE_WAIT_MS);
+        if (render) {
+            redrawFrames = redrawFrames > 0 ? redrawFrames - 1 : 0;
+            lastRender = now;
+
+            //The Profiler opens next to the Memory panel, the ROMS window moves to a column of its own
+            bool profilerColumn = chip8.debugMode && showProfiler;
+            chip8.graphics.extendScreen(profilerColumn ? 300 : 0);
+
+            // Update ImGui frame
+            ImGui_ImplSDLRenderer2_NewFrame();
+            ImGui_ImplSDL2_NewFrame();
+            ImGui::NewFrame();
 
         
 
-            //--------------------------------------------//
+            //Game Display
+            ImGui::SetNextWindowSize(ImVec2(chip8.graphics.WIDTH + 20, chip8.graphics.HEIGHT + 40));
+            ImGui::SetNextWindowPos(ImVec2(0, 0));
+            ImGui::Begin("Game", nullptr, chip8.debugMode ? 0 : ImGuiWindowFlags_NoTitleBar);
+            ImVec2 displaySize = chip8.graphics.displaySize();
+            ImVec2 cursor = ImGui::GetCursorPos();
+            ImGui::SetCursorPos(ImVec2(cursor.x + (chip8.graphics.WIDTH - displaySize.x) / 2, cursor.y + (chip8.graphics.HEIGHT - displaySize.y) / 2));
+            ImGui::Image((ImTextureID)chip8.graphics.texture, displaySize, ImVec2(0, 0), chip8.graphics.displayUV());
+            ImGui::End();
 
-            //Menu to Load ROM
-            ImGui::SetNextWindowSize(ImVec2(300, 360));
-            ImGui::SetNextWindowPos(ImVec2(942, 0));
-            ImGui::Begin("ROMS");
-            for (const auto & [key, value] : roms)
-            {
-                if(ImGui::Button(key.c_str()))
+            if(chip8.debugMode) {
+
+                //--------------------------------------------//
+
+                //Console Debug
+                ImGui::SetNextWindowSize(ImVec2(660, 360));
+                ImGui::SetNextWindowPos(ImVec2(0, 361));
+                ImGui::Begin("Debug Console", nullptr, ImGuiWindowFlags_HorizontalScrollbar);
+                //Print Console Stack
+                for (int i = 45; i >= 0; i--)
                 {
-                    //Print
-                    //cout << "Loading ROM: " << value << endl;
-                    chip8.pushLog("Loading ROM: " + value);
-                    chip8.unLoadROM();
-                    chip8.loadROM(value);
+                    ImGui::Text(chip8.console[i].c_str());
                 }
-            }
-            ImGui::End();
+                ImGui::End();
+
+                //--------------------------------------------//
+
+                //Emulator Memory
+                ImGui::SetNextWindowSize(ImVec2(282, 360));
+                ImGui::SetNextWindowPos(ImVec2(661, 0));
+                ImGui::Begin("Memory");
+                ImGui::Columns(2);
+                //Column for Registers
+                ImGui::Text("Registers");
+                for (int i = 0; i < 16; i++)
+                {
+                    ImGui::Text("V%X: %X", i, chip8.v[i]);
+                }
+                ImGui::NextColumn();
+                //Column for Timers
+                ImGui::Text("Counters/Timers");
+                ImGui::Text("PC: %X", chip8.pc);
+                ImGui::Text("I: %X", chip8.index);
+                ImGui::Text("SP: %X", chip8.sp);
+                ImGui::Text("Last Opcode: %X", chip8.lastOpcode);
+                ImGui::Text("Draw Flag: %s", chip8.drawFlag ? "True" : "False");
+                ImGui::Text("Resolution: %dx%d", chip8.displayWidth(), chip8.displayHeight());
+                ImGui::Text("Planes: %X", chip8.planes);
+                ImGui::Text("Pressed Key: %X", chip8.pressedKey);
+                ImGui::Text("Delay Timer: %X", chip8.delay_timer);
+                ImGui::Text("Sound Timer: %X", chip8.sound_timer);
+                ImGui::Columns(1);
+                ImGui::Checkbox("Profiler", &showProfiler);
+                ImGui::SameLine();
+                ImGui::Checkbox("Hex Editor", &showHexEditor);
+                //Display Wait quirk (DXYN waits for the next frame)
+                bool displayWait = chip8.quirks.vblank;
+                if (ImGui::Checkbox("Display Wait", &displayWait)) {
+                    Quirks quirks = chip8.quirks;
+                    quirks.vblank = displayWait;
+                    chip8.setQuirks(quirks);
+                }
+                if (chip8.quirks.vblank) {
+                    ImGui::SameLine();
+                    ImGui::Text("%u/%u skipped", chip8.lastWaitSkipped, chip8.ipf);
+                }
+                //Idle loops (timer/key waits fast-forwarded to the end of the frame)
+                ImGui::Checkbox("Skip Idle Loops", &chip8.idleSkip);
+                if (chip8.idleSkip) {
+                    ImGui::SameLine();
+                    ImGui::Text("%u/%u skipped", chip8.lastIdleSkipped, chip8.ipf);
+                }
+                //Display effects (CPU upscaler and post-process of the game texture)
+                ImGui::SetNextItemWidth(120);
+                if (ImGui::BeginCombo("Upscaler", Upscaler::name(chip8.graphics.upscaler.mode))) {
+                    for (int mode = 0; mode < Upscaler::MODES; mode++)
+                    {
+                        if (ImGui::Selectable(Upscaler::name(mode), chip8.graphics.upscaler.mode == mode)) {
+                            chip8.graphics.upscaler.mode = mode;
+                            chip8.drawFlag = true;
+                        }
+                    }
+                    ImGui::EndCombo();
+                }
+                ImGui::SetNextItemWidth(120);
+                if (ImGui::SliderInt("Phosphor", &chip8.graphics.effects.decay, 0, 240)) {
+                    chip8.graphics.invalidate();
+                    chip8.drawFlag = true;
+                }
+                if (ImGui::Checkbox("Scanlines", &chip8.graphics.effects.scanlines)) {
+                    chip8.graphics.invalidate();
+                    chip8.drawFlag = true;
+                }
+                ImGui::SameLine();
+                ImGui::TextDisabled("%s", PostProcess::kernels());
+                //Gameplay recording (F3)
+                if (ImGui::Button(chip8.recorder.recording() ? "Stop Recording" : "Record")) {
+                    toggleRecording(chip8);
+                }
+                if (chip8.recorder.recording()) {
+                    ImGui::SameLine();
+                    ImGui::Text("%llu frames, %llu KB", chip8.recorder.frames(), chip8.recorder.bytes() / 1024);
+                    if (chip8.recorder.dropped() > 0) {
+                        ImGui::SameLine();
+                        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%llu dropped", chip8.recorder.dropped());
+                    }
+                }
+                ImGui::End();
 
-        }
+                //--------------------------------------------//
 
-        //--------------------------------------------//
+                //Hex Editor (visible rows only, bytes stored to last frame highlighted)
+                if (showHexEditor) {
+                    ImGui::SetNextWindowSize(ImVec2(560, 400), ImGuiCond_FirstUseEver);
+                    ImGui::SetNextWindowPos(ImVec2(100, 100), ImGuiCond_FirstUseEver);
+                    ImGui::Begin("Hex Editor", &showHexEditor);
 
-        ImGui::Render();
+                    ImGui::SetNextItemWidth(60);
+                    if (ImGui::InputTextWithHint("##goto", "Addr", gotoAddress, sizeof(gotoAddress),
+                            ImGuiInputTextFlags_CharsHexadecimal | ImGuiInputTextFlags_EnterReturnsTrue)) {
+                        scrollToRow = (int)(strtoul(gotoAddress, nullptr, 16) % chip8.addressSpace()) / 16;
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::Button("Go to PC")) {
+                        scrollToRow = chip8.pc / 16;
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::Button("Go to I")) {
+                        scrollToRow = (chip8.index % chip8.addressSpace()) / 16;
+                    }
+                    ImGui::SameLine();
+                    ImGui::TextColored(ImVec4(1.0f, 0.8f, 0.2f, 1.0f), "changed");
+                    ImGui::SameLine();
+                    ImGui::TextColored(ImVec4(0.4f, 1.0f, 0.4f, 1.0f), "PC");
+                    ImGui::SameLine();
+                    ImGui::TextColored(ImVec4(0.4f, 0.8f, 1.0f, 1.0f), "I");
+
+                    ImGui::BeginChild("hex");
+                    float lineHeight = ImGui::GetTextLineHeightWithSpacing();
+                    if (scrollToRow >= 0) {
+                        ImGui::SetScrollY(scrollToRow * lineHeight);
+                        scrollToRow = -1;
+                    }
 
-        SDL_SetRenderDrawColor(chip8.graphics.renderer, 0, 0, 0, 255);
-        SDL_RenderClear(chip8.graphics.renderer);
+                    float byteWidth = ImGui::CalcTextSize("00").x;
+                    ImGuiListClipper clipper;
+                    clipper.Begin((int)(chip8.addressSpace() / 16), lineHeight);
+                    while (clipper.Step())
+                    {
+                        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+                        {
+                            unsigned int base = row * 16;
+                            ImGui::Text("%04X:", base);
+
+                            char ascii[17];
+                            for (unsigned int i = 0; i < 16; i++)
+                            {
+                                unsigned int address = base + i;
+                                unsigned char value = chip8.peek(address);
+                                ascii[i] = value >= 0x20 && value < 0x7F ? (char)value : '.';
+
+                                ImGui::SameLine(0, i == 8 ? 12.0f : 6.0f);
+                                ImGui::PushID((int)address);
+
+                                //Editing: hex input in place of the byte
+                                if ((int)address == editAddress) {
+                                    ImGui::SetNextItemWidth(byteWidth + 4);
+                                    ImGui::SetKeyboardFocusHere();
+                                    if (ImGui::InputText("##edit", editValue, sizeof(editValue),
+                                            ImGuiInputTextFlags_CharsHexadecimal | ImGuiInputTextFlags_EnterReturnsTrue | ImGuiInputTextFlags_AutoSelectAll)) {
+                                        if (editValue[0] != 0) {
+                                            chip8.poke(address, (unsigned char)strtoul(editValue, nullptr, 16));
+                                        }
+                                        editAddress = -1;
+                                    } else if (ImGui::IsItemDeactivated()) {
+                                        editAddress = -1;
+                                    }
+                                    ImGui::PopID();
+                                    continue;
+                                }
+
+                                ImVec4 color = ImGui::GetStyleColorVec4(ImGuiCol_Text);
+                                if (chip8.changedLastFrame(address)) {
+                                    color = ImVec4(1.0f, 0.8f, 0.2f, 1.0f);
+                                } else if (address == chip8.pc || address == (unsigned int)(chip8.pc + 1)) {
+                                    color = ImVec4(0.4f, 1.0f, 0.4f, 1.0f);
+                                } else if (address == chip8.index) {
+                                    color = ImVec4(0.4f, 0.8f, 1.0f, 1.0f);
+                                }
+
+                                char text[3];
+                                snprintf(text, sizeof(text), "%02X", value);
+                                ImGui::PushStyleColor(ImGuiCol_Text, color);
+                                if (ImGui::Selectable(text, false, ImGuiSelectableFlags_AllowDoubleClick, ImVec2(byteWidth, 0)) &&
+                                        ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) {
+                                    editAddress = (int)address;
+                                    snprintf(editValue, sizeof(editValue), "%02X", value);
+                                }
+                                ImGui::PopStyleColor();
+                                ImGui::PopID();
+                            }
+                            ascii[16] = 0;
+                            ImGui::SameLine(0, 12.0f);
+                            ImGui::TextUnformatted(ascii);
+                        }
+                    }
+                    ImGui::EndChild();
+                    ImGui::End();
+                }
 
-        // Render Behind
+                //--------------------------------------------//
 
-        ImGui_ImplSDLRenderer2_RenderDrawData(ImGui::GetDrawData(), chip8.graphics.renderer);
+                //Execution Profiler (heatmap + hottest addresses)
+                if (showProfiler) {
+                    ImGui::SetNextWindowSize(ImVec2(300, 360));
+                    ImGui::SetNextWindowPos(ImVec2(942, 0));
+                    ImGui::Begin("Profiler", &showProfiler);
 
-        // Render Front
+                    Profiler& profiler = chip8.profiler;
+                    ImGui::Text("Instructions: %llu", profiler.total);
+                    ImGui::SameLine();
+                    if (ImGui::Button("Reset")) {
+                        profiler.reset();
+                        hotAddresses.clear();
+                    }
+                    ImGui::RadioButton("Exec", &profilerView, 0);
+                    ImGui::SameLine();
+                    ImGui::RadioButton("Read", &profilerView, 1);
+                    ImGui::SameLine();
+                    ImGui::RadioButton("Write", &profilerView, 2);
+
+                    const unsigned int* counts = profilerView == 0 ? profiler.executions : profilerView == 1 ? profiler.reads : profiler.writes;
+
+                    //Heatmap: 64 x 64 cells over the address space (several addresses per cell above 4KB)
+                    const int CELLS = 64;
+                    const float CELL_SIZE = 4.0f;
+                    unsigned int perCell = chip8.addressSpace() / (CELLS * CELLS);
+                    static unsigned long long cells[CELLS * CELLS];
+                    unsigned long long hottestCell = 0;
+                    for (int c = 0; c < CELLS * CELLS; c++)
+                    {
+                        cells[c] = 0;
+                        for (unsigned int a = 0; counts != NULL && a < perCell; a++)
+                        {
+                            cells[c] += counts[c * perCell + a];
+                        }
+                        hottestCell = std::max(hottestCell, cells[c]);
+                    }
 
-        SDL_RenderPresent(chip8.graphics.renderer);
+                    ImDrawList* drawList = ImGui::GetWindowDrawList();
+                    ImVec2 origin = ImGui::GetCursorScreenPos();
+                    float logMax = logf(1.0f + (float)hottestCell);
+                    for (int c = 0; c < CELLS * CELLS; c++)
+                    {
+                        //Log scale so a few hot loops don't wash out everything else
+                        float heat = cells[c] == 0 ? 0.0f : logf(1.0f + (float)cells[c]) / logMax;
+                        ImU32 color = cells[c] == 0 ? IM_COL32(20, 20, 30, 255) :
+                            IM_COL32((int)(60 + 195 * heat), (int)(200 * heat * heat), (int)(120 * (1.0f - heat)), 255);
+                        ImVec2 min(origin.x + (c % CELLS) * CELL_SIZE, origin.y + (c / CELLS) * CELL_SIZE);
+                        drawList->AddRectFilled(min, ImVec2(min.x + CELL_SIZE, min.y + CELL_SIZE), color);
+                    }
 
+                    //Current PC
+                    int pcCell = chip8.pc / perCell;
+                    ImVec2 pcMin(origin.x + (pcCell % CELLS) * CELL_SIZE, origin.y + (pcCell / CELLS) * CELL_SIZE);
+                    drawList->AddRect(pcMin, ImVec2(pcMin.x + CELL_SIZE, pcMin.y + CELL_SIZE), IM_COL32(255, 255, 255, 255));
+
+                    ImGui::InvisibleButton("heatmap", ImVec2(CELLS * CELL_SIZE, CELLS * CELL_SIZE));
+                    if (ImGui::IsItemHovered()) {
+                        ImVec2 mouse = ImGui::GetIO().MousePos;
+                        int cx = std::min(CELLS - 1, std::max(0, (int)((mouse.x - origin.x) / CELL_SIZE)));
+                        int cy = std::min(CELLS - 1, std::max(0, (int)((mouse.y - origin.y) / CELL_SIZE)));
+                        int c = cy * CELLS + cx;
+                        ImGui::BeginTooltip();
+                        ImGui::Text("%04X-%04X: %llu", c * perCell, (c + 1) * perCell - 1, cells[c]);
+                        ImGui::EndTooltip();
+                    }
 
+                    //Hottest Addresses (refreshed twice a second)
+                    if (chip8.frameCount >= hotRefresh || chip8.frameCount + 30 < hotRefresh) {
+                        profiler.hottest(counts, 16, hotAddresses);
+                        hotRefresh = chip8.frameCount + 30;
+                    }
+                    unsigned long long viewTotal = 0;
+                    for (int c = 0; c < CELLS * CELLS; c++)
+                    {
+                        viewTotal += cells[c];
+                    }
+                    if (ImGui::BeginTable("hot", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV)) {
+                        ImGui::TableSetupColumn("Address");
+                        ImGui::TableSetupColumn("Count");
+                        ImGui::TableSetupColumn("%");
+                        ImGui::TableHeadersRow();
+                        for (const Profiler::HotAddress& hot : hotAddresses)
+                        {
+                            ImGui::TableNextRow();
+                            ImGui::TableNextColumn();
+                            ImGui::Text("%03X", hot.address);
+                            ImGui::TableNextColumn();
+                            ImGui::Text("%u", hot.count);
+                            ImGui::TableNextColumn();
+                            ImGui::Text("%.1f", viewTotal ? 100.0 * hot.count / viewTotal : 0.0);
+                        }
+                        ImGui::EndTable();
+                    }
 
+                    //Opcode Classes
+                    if (ImGui::CollapsingHeader("Opcode Classes")) {
+                        for (int c = 0; c < Profiler::OP_CLASSES; c++)
+                        {
+                            if (profiler.classCount[c] == 0) {
+                                continue;
+                            }
+                            float share = (float)profiler.classCount[c] / (float)profiler.total;
+                            ImGui::ProgressBar(share, ImVec2(120, 0));
+                            ImGui::SameLine();
+                            ImGui::Text("%s: %llu", Profiler::className(c), profiler.classCount[c]);
+                        }
+                    }
 
+                    //Call Graph (CALL/RET tree, exported for flamegraphs)
+                    if (ImGui::CollapsingHeader("Call Graph")) {
+                        CallGraph& graph = chip8.callGraph;
+                        ImGui::Checkbox("Record Calls", &recordCalls);
+                        ImGui::SetNextItemWidth(100);
+                        if (ImGui::InputInt("Sample Every", &callSampleInterval)) {
+                            callSampleInterval = std::max(1, callSampleInterval);
+                            graph.interval = callSampleInterval;
+                        }
+                        if (ImGui::Button("Clear")) {
+                            graph.reset(graph.nodes[0].address);
+                        }
 
+                        //Exports go to profiles/<rom>.folded / <rom>.speedscope.json
+                        fs::path profiles = fs::current_path() / "../profiles";
+                        std::string stem = chip8.romPath.empty() ? "chip8" : fs::path(chip8.romPath).stem().string();
+                        ImGui::SameLine();
+                        if (ImGui::Button("Export Folded")) {
+                            std::error_code ec;
+                            fs::create_directories(profiles, ec);
+                            std::string path = (profiles / (stem + ".folded")).string();
+                            chip8.pushLog(graph.saveFolded(path) ? "Saved " + path : "Failed to save " + path);
+                        }
+                        ImGui::SameLine();
+                        if (ImGui::Button("Export Speedscope")) {
+                            std::error_code ec;
+                            fs::create_directories(profiles, ec);
+                            std::string path = (profiles / (stem + ".speedscope.json")).string();
+                            chip8.pushLog(graph.saveSpeedscope(path, stem) ? "Saved " + path : "Failed to save " + path);
+                        }
 
+                        ImGui::Text("Nodes: %zu", graph.nodes.size());
+                        drawCallNode(graph, 0, graph.total(0));
+                    }
 
+                    ImGui::End();
+                }
 
+        
 
+                //--------------------------------------------//
 
+                //Menu to Load ROM
+                ImGui::SetNextWindowSize(ImVec2(300, profilerColumn ? 720 : 360));
+                ImGui::SetNextWindowPos(ImVec2(profilerColumn ? 1242 : 942, 0));
+                ImGui::Begin("ROMS");
 
+                //Search (type to filter)
+                if (ImGui::IsWindowAppearing()) {
+                    ImGui::SetKeyboardFocusHere();
+                }
+                ImGui::SetNextItemWidth(-1);
+                ImGui::InputTextWithHint("##filter", library.busy() ? "Search (indexing...)" : "Search", romFilter, sizeof(romFilter));
+
+                if (ImGui::Checkbox("Hot Reload", &hotReload)) {
+                    if (hotReload && !chip8.romPath.empty()) {
+                        romWatcher.watch(chip8.romPath);
+                    } else {
+                        romWatcher.stop();
+                    }
+                }
+                ImGui::SameLine();
+                ImGui::Checkbox("Keep Registers", &hotReloadKeepRegisters);
+
+                //New library snapshot when it changed, at most twice a second while
+                //indexing (the generation moves every 64 hashes)
+                bool refilter = appliedFilter != romFilter;
+                if (romsGeneration != library.generation() &&
+                        (!library.busy() || SDL_GetTicks() - romsSnapshotTime >= ROMS_REFRESH_MS)) {
+                    romsGeneration = library.generation();
+                    romsSnapshotTime = SDL_GetTicks();
+                    library.snapshot(roms);
+                    refilter = true;
+                }
 
+                //Re-filter only when the snapshot or the search text changed
+                if (refilter) {
+                    appliedFilter = romFilter;
 
+                    std::string needle = appliedFilter;
+                    std::transform(needle.begin(), needle.end(), needle.begin(), ::tolower);
+                    filteredRoms.clear();
+                    for (int i = 0; i < (int)roms.size(); i++)
+                    {
+                        std::string title = roms[i].title;
+                        std::transform(title.begin(), title.end(), title.begin(), ::tolower);
+                        if (title.find(needle) != std::string::npos) {
+                            filteredRoms.push_back(i);
+                        }
+                    }
+                }
 
+                //Only the visible rows are submitted
+                ImGui::BeginChild("##romlist");
+                ImGuiListClipper clipper;
+                clipper.Begin((int)filteredRoms.size());
+                while (clipper.Step())
+                {
+                    for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+                    {
+                        const RomEntry& rom = roms[filteredRoms[row]];
+                        ImGui::PushID(row);
+                        if (ImGui::Selectable(rom.title.c_str()))
+                        {
+                            chip8.pushLog("Loading ROM: " + rom.path);
+                            Platform previous = chip8.platform;
+                            chip8.platform = rom.platform;
+                            ROMResult result = chip8.loadROM(rom.path);
+                            if (result.status != ROMStatus::OK) {
+                                //The running program (and its platform) stay
+                                chip8.platform = previous;
+                                chip8.pushLog("Failed to load ROM: " + result.message);
+                            } else if (result.identified) {
+                                chip8.pushLog("Identified: " + result.title + " (" + std::to_string(chip8.ipf) + " instructions/frame)");
+                            }
+                            if (hotReload && result.status == ROMStatus::OK) {
+                                romWatcher.watch(rom.path);
+                            }
+                        }
+                        if (ImGui::IsItemHovered()) {
+                            ImGui::SetTooltip("%s\n%llu bytes\nSHA-1: %s", rom.path.c_str(), rom.size,
+                                rom.hashed ? SHA1::toHex(rom.sha1).c_str() : "(pending)");
+                        }
+                        ImGui::PopID();
+                    }
+                }
+                ImGui::EndChild();
+                ImGui::End();
 
+                //--------------------------------------------//
 
+                //Debugger (Breakpoints + Watchpoints)
+                ImGui::SetNextWindowSize(ImVec2(581, 360));
+                ImGui::SetNextWindowPos(ImVec2(661, 361));
+                ImGui::Begin("Debugger");
 
-        //Emulator Loop (Frame) 
-        chip8.cycle();
+                ImGui::Text("%s", chip8.debugger.describeStop().c_str());
+                if (chip8.debugger.paused) {
+                    if (ImGui::Button("Continue")) {
+                        chip8.debugger.resume(chip8.pc);
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::Button("Step")) {
+                        if (chip8.step()) {
+                            chip8.updateTimers();
+                        }
+                        chip8.latchWrites();
+                    }
+                    ImGui::BeginDisabled(chip8.journal.empty());
+                    ImGui::SameLine();
+                    if (ImGui::Button("Step Back")) {
+                        chip8.stepBack();
+                        chip8.latchWrites();
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::Button("Reverse Continue")) {
+                        chip8.reverseContinue();
+                        chip8.latchWrites();
+                        chip8.pushLog("Reverse: " + chip8.debugger.describeStop());
+                    }
+                    ImGui::EndDisabled();
+                } else if (ImGui::Button("Pause")) {
+                    chip8.debugger.pause(Debugger::StopReason::User, chip8.pc);
+                }
+                ImGui::SameLine();
+                ImGui::Checkbox("Record History", &recordHistory);
+                ImGui::SameLine();
+                ImGui::TextDisabled("%zu steps, %zu KB", chip8.journal.records(), chip8.journal.bytes() / 1024);
+                ImGui::SameLine();
+                ImGui::Checkbox("Disassembly", &showDisassembly);
+
+                ImGui::SeparatorText("GDB Server");
+                if (gdbStub.listening()) {
+                    ImGui::Text("%s on %s", gdbStub.connected() ? "Connected" : "Listening", gdbStub.endpoint().c_str());
+                    ImGui::SameLine();
+                    if (ImGui::Button("Stop##gdb")) {
+                        gdbStub.stop();
+                    }
+                } else {
+                    ImGui::SetNextItemWidth(100);
+                    ImGui::InputInt("Port", &gdbPort);
+                    ImGui::SameLine();
+                    if (ImGui::Button("Start##gdb")) {
+                        std::string error;
+                        if (gdbStub.listenTcp((unsigned short)gdbPort, error)) {
+                            chip8.pushLog("GDB server on " + gdbStub.endpoint());
+                        } else {
+                            chip8.pushLog("GDB server: " + error);
+                        }
+                    }
+                }
 
-        //Update Display
-        if(chip8.drawFlag)
-        {
-            chip8.drawFlag = false;
-            chip8.updateDisplay();
+                ImGui::SeparatorText("Breakpoints");
+                ImGui::SetNextItemWidth(60);
+                ImGui::InputTextWithHint("##bpaddr", "Addr", breakAddress, sizeof(breakAddress), ImGuiInputTextFlags_CharsHexadecimal);
+                ImGui::SameLine();
+                ImGui::SetNextItemWidth(200);
+                ImGui::InputTextWithHint("##bpcond", "Condition (V3 == 0x10)", breakCondition, sizeof(breakCondition));
+                ImGui::SameLine();
+                if (ImGui::Button("Add##bp") && breakAddress[0] != 0) {
+                    unsigned short address = (unsigned short)strtoul(breakAddress, nullptr, 16);
+                    debuggerError.clear();
+                    if (chip8.debugger.addBreakpoint(address, breakCondition, debuggerError)) {
+                        breakAddress[0] = 0;
+                        breakCondition[0] = 0;
+                    }
+                }
+                if (!debuggerError.empty()) {
+                    ImGui::TextColored(ImVec4(1, 0.4f, 0.4f, 1), "%s", debuggerError.c_str());
+                }
+                for (size_t i = 0; i < chip8.debugger.breakpoints.size(); i++)
+                {
+                    const Debugger::Breakpoint& breakpoint = chip8.debugger.breakpoints[i];
+                    ImGui::PushID((int)i);
+                    if (ImGui::SmallButton("x")) {
+                        chip8.debugger.removeBreakpoint(breakpoint.address);
+                        ImGui::PopID();
+                        break;
+                    }
+                    ImGui::SameLine();
+                    ImGui::Text("%03X %s", breakpoint.address, breakpoint.conditional ? breakpoint.text.c_str() : "");
+                    ImGui::PopID();
+                }
+
+                ImGui::SeparatorText("Watchpoints");
+                ImGui::SetNextItemWidth(60);
+                ImGui::InputTextWithHint("##wpaddr", "Addr", watchAddress, sizeof(watchAddress), ImGuiInputTextFlags_CharsHexadecimal);
+                ImGui::SameLine();
+                ImGui::SetNextItemWidth(80);
+                ImGui::InputInt("Len", &watchLength);
+                ImGui::SameLine();
+                ImGui::Checkbox("R", &watchRead);
+                ImGui::SameLine();
+                ImGui::Checkbox("W", &watchWrite);
+                ImGui::SameLine();
+                if (ImGui::Button("Add##wp") && watchAddress[0] != 0 && (watchRead || watchWrite)) {
+                    unsigned short address = (unsigned short)strtoul(watchAddress, nullptr, 16);
+                    unsigned char mode = (watchRead ? Debugger::WATCH_READ : 0) | (watchWrite ? Debugger::WATCH_WRITE : 0);
+                    chip8.debugger.addWatchpoint(address, (unsigned short)std::max(1, std::min(watchLength, 0xFFFF)), mode);
+                    watchAddress[0] = 0;
+                }
+                for (size_t i = 0; i < chip8.debugger.watchpoints.size(); i++)
+                {
+                    const Debugger::Watchpoint& watchpoint = chip8.debugger.watchpoints[i];
+                    ImGui::PushID(1000 + (int)i);
+                    if (ImGui::SmallButton("x")) {
+                        chip8.debugger.removeWatchpoint(i);
+                        ImGui::PopID();
+                        break;
+                    }
+                    ImGui::SameLine();
+                    ImGui::Text("%03X-%03X %s%s", watchpoint.address, watchpoint.address + watchpoint.length - 1,
+                        (watchpoint.mode & Debugger::WATCH_READ) ? "R" : "", (watchpoint.mode & Debugger::WATCH_WRITE) ? "W" : "");
+                    ImGui::PopID();
+                }
+
+                ImGui::SeparatorText("Trace Points");
+                ImGui::SetNextItemWidth(50);
+                ImGui::InputTextWithHint("##trstart", "From", traceStart, sizeof(traceStart), ImGuiInputTextFlags_CharsHexadecimal);
+                ImGui::SameLine();
+                ImGui::SetNextItemWidth(50);
+                ImGui::InputTextWithHint("##trend", "To", traceEnd, sizeof(traceEnd), ImGuiInputTextFlags_CharsHexadecimal);
+                ImGui::SameLine();
+                ImGui::SetNextItemWidth(50);
+                ImGui::InputTextWithHint("##trmask", "Mask", traceMask, sizeof(traceMask), ImGuiInputTextFlags_CharsHexadecimal);
+                ImGui::SameLine();
+                ImGui::SetNextItemWidth(50);
+                ImGui::InputTextWithHint("##trmatch", "Opcode", traceMatch, sizeof(traceMatch), ImGuiInputTextFlags_CharsHexadecimal);
+                ImGui::SameLine();
+                ImGui::SetNextItemWidth(150);
+                ImGui::InputTextWithHint("##trcond", "Condition", traceCondition, sizeof(traceCondition));
+                ImGui::SameLine();
+                if (ImGui::Button("Add##tr")) {
+                    //Empty fields match everything
+                    unsigned short start = traceStart[0] ? (unsigned short)strtoul(traceStart, nullptr, 16) : 0x0000;
+                    unsigned short end = traceEnd[0] ? (unsigned short)strtoul(traceEnd, nullptr, 16) : 0xFFFF;
+                    unsigned short mask = traceMask[0] ? (unsigned short)strtoul(traceMask, nullptr, 16) : (traceMatch[0] ? 0xFFFF : 0x0000);
+                    unsigned short match = traceMatch[0] ? (unsigned short)strtoul(traceMatch, nullptr, 16) : 0x0000;
+                    traceError.clear();
+                    if (chip8.tracer.addPoint(start, end, mask, match, traceCondition, traceError)) {
+                        traceStart[0] = 0;
+                        traceEnd[0] = 0;
+                        traceMask[0] = 0;
+                        traceMatch[0] = 0;
+                        traceCondition[0] = 0;
+                    }
+                }
+                if (!traceError.empty()) {
+                    ImGui::TextColored(ImVec4(1, 0.4f, 0.4f, 1), "%s", traceError.c_str());
+                }
+                for (size_t i = 0; i < chip8.tracer.points.size(); i++)
+                {
+                    const Tracer::TracePoint& point = chip8.tracer.points[i];
+                    ImGui::PushID(2000 + (int)i);
+                    if (ImGui::SmallButton("x")) {
+                        chip8.tracer.removePoint(i);
+                        ImGui::PopID();
+                        break;
+                    }
+                    ImGui::SameLine();
+                    ImGui::Text("%03X-%03X op&%04X==%04X %s", point.start, point.end, point.mask, point.match, point.text.c_str());
+                    ImGui::PopID();
+                }
+
+                //Trace file: traces/<rom>.c8trace (read with chip8-trace)
+                if (chip8.tracer.recording()) {
+                    if (ImGui::Button("Stop Trace")) {
+                        chip8.tracer.close();
+                        chip8.pushLog("Trace saved: " + chip8.tracer.fileName());
+                    }
+                    ImGui::SameLine();
+                    ImGui::Text("%llu records", chip8.tracer.records());
+                } else if (ImGui::Button("Start Trace")) {
+                    fs::path traces = fs::current_path() / "../traces";
+                    std::error_code ec;
+                    fs::create_directories(traces, ec);
+                    std::string stem = chip8.romPath.empty() ? "chip8" : fs::path(chip8.romPath).stem().string();
+                    std::string error;
+                    if (!chip8.tracer.open((traces / (stem + ".c8trace")).string(), error)) {
+                        chip8.pushLog("Trace: " + error);
+                    }
+                }
+                ImGui::SameLine();
+                ImGui::TextDisabled("(no trace points: every instruction)");
+                ImGui::End();
+
+                //--------------------------------------------//
+
+                //Disassembly (only the visible rows are decoded, cached per address)
+                if (showDisassembly) {
+                    ImGui::SetNextWindowSize(ImVec2(300, 500), ImGuiCond_FirstUseEver);
+                    ImGui::SetNextWindowPos(ImVec2(661, 0), ImGuiCond_FirstUseEver);
+                    ImGui::Begin("Disassembly", &showDisassembly);
+                    ImGui::Checkbox("Follow PC", &followPC);
+                    ImGui::SameLine();
+                    ImGui::TextDisabled("Click a line to toggle a breakpoint");
+
+                    ImGui::BeginChild("code");
+                    float lineHeight = ImGui::GetTextLineHeightWithSpacing();
+
+                    //Rows are 2 bytes apart, aligned on the PC
+                    unsigned int align = chip8.pc & 1;
+                    int rows = (int)(chip8.addressSpace() / 2);
+
+                    //Keep the PC in view when it moves off screen
+                    if (followPC && chip8.pc != followedPC) {
+                        float pcY = (chip8.pc / 2) * lineHeight;
+                        if (pcY < ImGui::GetScrollY() || pcY > ImGui::GetScrollY() + ImGui::GetWindowHeight() - lineHeight) {
+                            ImGui::SetScrollY(pcY - ImGui::GetWindowHeight() / 2);
+                        }
+                        followedPC = chip8.pc;
+                    }
+
+                    ImGuiListClipper clipper;
+                    clipper.Begin(rows, lineHeight);
+                    while (clipper.Step())
+                    {
+                        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+                        {
+                            unsigned short address = (unsigned short)(row * 2 + align);
+                            const Disassembler::Line& line = disassembler.line(chip8, address);
+                            bool breakpoint = (chip8.debugger.flags[address] & Debugger::BREAK) != 0;
+
+                            char label[64];
+                            snprintf(label, sizeof(label), "%s %03X  %02X%02X  %s##%X", breakpoint ? "*" : " ", address,
+                                chip8.peek(address), chip8.peek(address + 1), line.text.c_str(), address);
+
+                            if (breakpoint) {
+                                ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.4f, 0.4f, 1.0f));
+                            }
+                            if (ImGui::Selectable(label, address == chip8.pc)) {
+                                if (breakpoint) {
+                                    chip8.debugger.removeBreakpoint(address);
+                                } else {
+                                    std::string error;
+                                    chip8.debugger.addBreakpoint(address, "", error);
+                                }
+                            }
+                            if (breakpoint) {
+                                ImGui::PopStyleColor();
+                            }
+                        }
+                    }
+                    ImGui::EndChild();
+                    ImGui::End();
+                }
+
+            }
+
+            //--------------------------------------------//
+
+            if (showTiming) {
+                drawFrameTiming(timing, chip8.graphics);
+            }
+
+            ImGui::Render();
         }
-        
+        timing.mark(FrameTiming::UI);
+
+        //5. Present, once per frame (waits for the vertical blank with VSync)
+        if (render) {
+            chip8.graphics.present();
+        }
+        timing.mark(FrameTiming::PRESENT);
+
+        //Frames that did some work (idle wake-ups would hide the real costs)
+        if (frameRan || render) {
+            timing.commit();
+        }
+
         if (!chip8.graphics.window) {
             quit = true;
         }
- 
-        //Sleep
-        SDL_Delay(16);
 
-        //Delay Timer
-        if(chip8.delay_timer > 0) {
-            chip8.delay_timer--;
+        //6. Sleep until the next frame, a redraw or input
+        Uint32 wait = IDLE_WAIT_MS;
+        now = SDL_GetTicks();
+        if (running) {
+            wait = (Sint32)(nextFrame - now) > 0 ? nextFrame - now : 0;
+        } else if (gdbStub.listening()) {
+            wait = FRAME_MS;
         }
-        
-        //Sound Timer
-        if(chip8.sound_timer > 0) {
-            if (chip8.sound_timer == 1)
-            {
-                chip8.pushLog("BEEP");
-                Beep(523,100); // 523 hertz (C5) for 500 milliseconds 
-            }
-            chip8.sound_timer--;
+        if (redrawFrames > 0 && wait > FRAME_MS) {
+            wait = FRAME_MS;
+        }
+        if (wait > 0) {
+            SDL_WaitEventTimeout(NULL, (int)wait);
         }
     }
 
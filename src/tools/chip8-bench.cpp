@@ -0,0 +1,327 @@
+/*
+    chip8-bench
+
+    Interpreter micro-benchmarks. Each benchmark is a small synthetic ROM
+    looping over one instruction family; it runs headless with a large
+    instructions-per-frame count and reports ns/instruction and
+    instructions/second (best of N runs). On Linux, host cycles,
+    instructions, branch misses and cache misses are read with
+    perf_event_open when the kernel allows it (null otherwise).
+
+        chip8-bench [--filter NAME] [--runs N] [--instructions N] [--label TEXT]
+
+    Results are printed as a table on stderr and as JSON on stdout, so runs
+    of different commits can be compared:
+
+        ./chip8-bench --label $(git rev-parse --short HEAD) > bench.json
+
+    Build (same sources and libraries as the emulator):
+        g++ -O2 -std=c++17 -Isrc/include/SDL2 -Isrc/include/imgui -Isrc/include/chip8 -Lsrc/lib
+            src/tools/chip8-bench.cpp @src/cpp_files_list.txt -lmingw32 -lSDL2main -lSDL2 -lws2_32 -o chip8-bench
+*/
+#include <chip8.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+
+struct Benchmark {
+    const char* name;
+    const char* description;
+    vector<unsigned short> program;         // Opcodes from 0x200 (ends with a jump back)
+};
+
+//Sprite data for the DXYN benchmarks lives at 0x300
+static const unsigned short SPRITE = 0x300;
+
+static vector<Benchmark> benchmarks() {
+
+    vector<Benchmark> list;
+
+    //8XYN: every ALU operation, results feeding the next one
+    list.push_back({ "alu", "8XY0-8XYE", {
+        0x6001, 0x6103, 0x6205, 0x6307,
+        0x8014, 0x8125, 0x8231, 0x8342, 0x8403, 0x8016, 0x811E, 0x8237, 0x8300,
+        0x8014, 0x8125, 0x8231, 0x8342, 0x8403, 0x8016, 0x811E, 0x8237, 0x8300,
+        0x1208
+    } });
+
+    //3XNN/4XNN/5XY0/9XY0/EX9E/EXA1, taken and not taken in turn
+    list.push_back({ "skips", "3XNN 4XNN 5XY0 9XY0 EX9E EXA1", {
+        0x7001, 0x3000, 0x6100, 0x4001, 0x6101, 0x5010, 0x6102, 0x9010,
+        0x6103, 0xE09E, 0x6104, 0xE0A1, 0x6105, 0x3001, 0x6106, 0x1200
+    } });
+
+    //DXYN at a few heights, moving so rows hit different words
+    list.push_back({ "draw-1", "DXY1", { 0xA000 | SPRITE, 0xD011, 0x7003, 0x7101, 0xD011, 0x7003, 0x1202 } });
+    list.push_back({ "draw-8", "DXY8", { 0xA000 | SPRITE, 0xD018, 0x7003, 0x7101, 0xD018, 0x7003, 0x1202 } });
+    list.push_back({ "draw-15", "DXYF", { 0xA000 | SPRITE, 0xD01F, 0x7003, 0x7101, 0xD01F, 0x7003, 0x1202 } });
+
+    //FX55/FX65 moving all 16 registers
+    list.push_back({ "memory", "FF55 FF65", { 0xA400, 0xFF55, 0xA400, 0xFF65, 0xA410, 0xFF55, 0xA410, 0xFF65, 0x1200 } });
+
+    //CALL/RET chain three levels deep
+    list.push_back({ "call-ret", "2NNN 00EE", {
+        0x2210, 0x2210, 0x1200, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x2220, 0x2220, 0x00EE, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x2230, 0x00EE, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x00EE
+    } });
+
+    return list;
+}
+
+
+//Host counters (Linux perf events)
+struct Counters {
+    bool available = false;
+    unsigned long long cycles = 0;
+    unsigned long long instructions = 0;
+    unsigned long long branchMisses = 0;
+    unsigned long long cacheMisses = 0;
+};
+
+#ifdef __linux__
+class PerfCounters {
+
+    public:
+        PerfCounters() {
+            const unsigned long long configs[4] = {
+                PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES
+            };
+            for (int i = 0; i < 4; i++)
+            {
+                perf_event_attr attr;
+                memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = configs[i];
+                attr.disabled = i == 0;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                fds[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds[0], 0);
+                if (fds[i] < 0) {
+                    close();
+                    return;
+                }
+            }
+        }
+
+        ~PerfCounters() {
+            close();
+        }
+
+        bool available() {
+            return fds[0] >= 0;
+        }
+
+        void start() {
+            if (available()) {
+                ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            }
+        }
+
+        Counters stop() {
+            Counters counters;
+            if (!available()) {
+                return counters;
+            }
+            ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+            unsigned long long values[4];
+            for (int i = 0; i < 4; i++)
+            {
+                if (read(fds[i], &values[i], sizeof(values[i])) != (ssize_t)sizeof(values[i])) {
+                    return counters;
+                }
+            }
+            counters.available = true;
+            counters.cycles = values[0];
+            counters.instructions = values[1];
+            counters.branchMisses = values[2];
+            counters.cacheMisses = values[3];
+            return counters;
+        }
+
+    private:
+        int fds[4] = { -1, -1, -1, -1 };
+
+        void close() {
+            for (int i = 3; i >= 0; i--)
+            {
+                if (fds[i] >= 0) {
+                    ::close(fds[i]);
+                    fds[i] = -1;
+                }
+            }
+        }
+};
+#else
+//No perf events: counters are reported as null
+class PerfCounters {
+    public:
+        bool available() { return false; }
+        void start() {}
+        Counters stop() { return Counters(); }
+};
+#endif
+
+
+struct Result {
+    string name;
+    string description;
+    unsigned long long instructions;
+    double seconds;
+    Counters counters;
+};
+
+static Result run(const Benchmark& benchmark, unsigned long long instructions, int runs, PerfCounters& perf) {
+
+    Result best;
+    best.name = benchmark.name;
+    best.description = benchmark.description;
+    best.seconds = -1;
+
+    for (int r = 0; r < runs; r++)
+    {
+        unique_ptr<Chip8> chip8(new Chip8(true));
+        chip8->unLoadROM();
+        for (size_t i = 0; i < benchmark.program.size(); i++)
+        {
+            chip8->poke(0x200 + i * 2, (unsigned char)(benchmark.program[i] >> 8));
+            chip8->poke(0x201 + i * 2, (unsigned char)benchmark.program[i]);
+        }
+        for (int i = 0; i < 16; i++)
+        {
+            chip8->poke(SPRITE + i, (unsigned char)(0xA5 ^ (i * 0x11)));
+        }
+
+        //Whole run in frames of 10000 instructions (timers and frame work included)
+        chip8->ipf = 10000;
+        unsigned long long frames = (instructions + chip8->ipf - 1) / chip8->ipf;
+
+        perf.start();
+        auto start = chrono::steady_clock::now();
+        for (unsigned long long f = 0; f < frames; f++)
+        {
+            chip8->cycle();
+            chip8->updateTimers();
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        Counters counters = perf.stop();
+
+        if (best.seconds < 0 || seconds < best.seconds) {
+            best.seconds = seconds;
+            best.instructions = frames * chip8->ipf;
+            best.counters = counters;
+        }
+    }
+    return best;
+}
+
+static void printCounter(bool available, unsigned long long value, bool last) {
+    if (available) {
+        printf("%llu%s", value, last ? "" : ", ");
+    } else {
+        printf("null%s", last ? "" : ", ");
+    }
+}
+
+//Text as the inside of a JSON string
+static string jsonEscape(const string& text) {
+    string escaped;
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if ((unsigned char)c < 0x20) {
+            char code[7];
+            snprintf(code, sizeof(code), "\\u%04x", (unsigned char)c);
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+int main(int argc, char** argv) {
+
+    string filter;
+    string label;
+    int runs = 5;
+    unsigned long long instructions = 20000000;
+    for (int i = 1; i < argc; i++)
+    {
+        string option = argv[i];
+        if (option == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (option == "--runs" && i + 1 < argc) {
+            runs = max(1, atoi(argv[++i]));
+        } else if (option == "--instructions" && i + 1 < argc) {
+            instructions = max(10000ULL, strtoull(argv[++i], nullptr, 10));
+        } else if (option == "--label" && i + 1 < argc) {
+            label = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: chip8-bench [--filter NAME] [--runs N] [--instructions N] [--label TEXT]\n");
+            return 1;
+        }
+    }
+
+    PerfCounters perf;
+    vector<Result> results;
+    fprintf(stderr, "%-10s %-32s %10s %14s %12s %12s\n", "benchmark", "instructions", "ns/instr", "instr/s", "br-miss", "cache-miss");
+    for (const Benchmark& benchmark : benchmarks())
+    {
+        if (!filter.empty() && filter != benchmark.name) {
+            continue;
+        }
+        Result result = run(benchmark, instructions, runs, perf);
+        results.push_back(result);
+
+        double ns = result.seconds * 1e9 / result.instructions;
+        fprintf(stderr, "%-10s %-32s %10.2f %14.0f", result.name.c_str(), result.description.c_str(), ns,
+            result.instructions / result.seconds);
+        if (result.counters.available) {
+            fprintf(stderr, " %12llu %12llu\n", result.counters.branchMisses, result.counters.cacheMisses);
+        } else {
+            fprintf(stderr, " %12s %12s\n", "-", "-");
+        }
+    }
+
+    //JSON
+    printf("{\n  \"label\": \"%s\",\n  \"perf_events\": %s,\n  \"benchmarks\": [\n", jsonEscape(label).c_str(), perf.available() ? "true" : "false");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const Result& result = results[i];
+        const Counters& counters = result.counters;
+        printf("    { \"name\": \"%s\", \"instructions\": %llu, \"seconds\": %.6f, \"ns_per_instruction\": %.3f, \"instructions_per_second\": %.0f, ",
+            result.name.c_str(), result.instructions, result.seconds, result.seconds * 1e9 / result.instructions,
+            result.instructions / result.seconds);
+        printf("\"host_cycles\": ");
+        printCounter(counters.available, counters.cycles, false);
+        printf("\"host_instructions\": ");
+        printCounter(counters.available, counters.instructions, false);
+        printf("\"branch_misses\": ");
+        printCounter(counters.available, counters.branchMisses, false);
+        printf("\"cache_misses\": ");
+        printCounter(counters.available, counters.cacheMisses, true);
+        printf(" }%s\n", i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+    return 0;
+}
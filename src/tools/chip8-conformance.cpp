@@ -0,0 +1,375 @@
+/*
+    chip8-conformance
+
+    Runs test ROMs headless for a fixed number of frames, hashes the final
+    display and compares it with the golden hash in the manifest. Every
+    ROM runs on its own Chip8 instance, spread over all cores.
+
+        chip8-conformance <manifest> [--roms DIR] [--threads N] [--update]
+
+    Manifest lines (# starts a comment):
+
+        name  rom  profile  frames  options  hash
+
+        rom         file under --roms, or hex:6005D015... for a program
+                    written in the manifest (loaded at 0x200)
+        profile     chip8, schip or xochip, optionally with quirk overrides:
+                    schip+vblank-jump (shift, incx, leavei, wrap, jump, vblank, logic)
+        options     - or a comma separated list of
+                    poke:1FF=01     write a byte after loading (Timendus test selection)
+                    key:A@10-12     hold key A during frames 10-12
+                    seed:1234       seed of the CXNN generator
+        hash        Chip8::displayHash() (SHA-1 of the packed display at its
+                    current resolution, second plane included once used),
+                    - when not recorded yet
+
+    A test without a hash (NEW) counts as failed; --update writes the
+    hashes of this run back into the manifest.
+
+    Build (same sources and libraries as the emulator):
+        g++ -O2 -std=c++17 -Isrc/include/SDL2 -Isrc/include/imgui -Isrc/include/chip8 -Lsrc/lib
+            src/tools/chip8-conformance.cpp @src/cpp_files_list.txt -lmingw32 -lSDL2main -lSDL2 -lws2_32 -o chip8-conformance
+*/
+#include <chip8.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+
+using namespace std;
+
+
+struct KeyPress {
+    int key;
+    unsigned long long first;
+    unsigned long long last;
+};
+
+struct Poke {
+    unsigned short address;
+    unsigned char value;
+};
+
+struct Test {
+    string name;
+    string rom;
+    string profile;
+    unsigned long long frames;
+    string options;
+    string golden;
+    int line;                       // Manifest line (for --update)
+
+    Platform platform;
+    Quirks quirks;
+    vector<KeyPress> keys;
+    vector<Poke> pokes;
+    unsigned int seed;
+
+    //Result
+    string hash;
+    string error;
+    double milliseconds;
+};
+
+
+static bool setQuirk(Quirks& quirks, const string& name, bool on) {
+    if (name == "shift")  { quirks.shift = on; return true; }
+    if (name == "incx")   { quirks.memoryIncrementByX = on; return true; }
+    if (name == "leavei") { quirks.memoryLeaveIUnchanged = on; return true; }
+    if (name == "wrap")   { quirks.wrap = on; return true; }
+    if (name == "jump")   { quirks.jump = on; return true; }
+    if (name == "vblank") { quirks.vblank = on; return true; }
+    if (name == "logic")  { quirks.logic = on; return true; }
+    return false;
+}
+
+//"schip+vblank-jump"
+static bool parseProfile(const string& text, Platform& platform, Quirks& quirks) {
+
+    size_t end = text.find_first_of("+-");
+    string base = text.substr(0, end);
+    if (base == "chip8") {
+        platform = Platform::CHIP8;
+    } else if (base == "schip") {
+        platform = Platform::SCHIP;
+    } else if (base == "xochip") {
+        platform = Platform::XOCHIP;
+    } else {
+        return false;
+    }
+    quirks = Chip8::platformQuirks(platform);
+
+    while (end != string::npos)
+    {
+        bool on = text[end] == '+';
+        size_t next = text.find_first_of("+-", end + 1);
+        if (!setQuirk(quirks, text.substr(end + 1, next == string::npos ? string::npos : next - end - 1), on)) {
+            return false;
+        }
+        end = next;
+    }
+    return true;
+}
+
+static bool parseOptions(Test& test) {
+
+    test.seed = 1;
+    if (test.options == "-") {
+        return true;
+    }
+
+    stringstream list(test.options);
+    string option;
+    while (getline(list, option, ','))
+    {
+        unsigned int a;
+        unsigned int b;
+        unsigned long long first;
+        unsigned long long last;
+        if (sscanf(option.c_str(), "poke:%x=%x", &a, &b) == 2) {
+            test.pokes.push_back({ (unsigned short)a, (unsigned char)b });
+        } else if (sscanf(option.c_str(), "key:%x@%llu-%llu", &a, &first, &last) == 3 && a < 16) {
+            test.keys.push_back({ (int)a, first, last });
+        } else if (sscanf(option.c_str(), "key:%x@%llu", &a, &first) == 2 && a < 16) {
+            test.keys.push_back({ (int)a, first, first });
+        } else if (sscanf(option.c_str(), "seed:%u", &a) == 1) {
+            test.seed = a;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool loadManifest(const string& path, vector<Test>& tests, vector<string>& lines) {
+
+    ifstream file(path);
+    if (!file) {
+        cerr << "Can't open " << path << endl;
+        return false;
+    }
+
+    string line;
+    while (getline(file, line))
+    {
+        lines.push_back(line);
+        size_t start = line.find_first_not_of(" \t");
+        if (start == string::npos || line[start] == '#') {
+            continue;
+        }
+
+        Test test;
+        stringstream fields(line);
+        if (!(fields >> test.name >> test.rom >> test.profile >> test.frames >> test.options >> test.golden)) {
+            cerr << path << ":" << lines.size() << ": expected name rom profile frames options hash" << endl;
+            return false;
+        }
+        if (!parseProfile(test.profile, test.platform, test.quirks)) {
+            cerr << path << ":" << lines.size() << ": bad profile " << test.profile << endl;
+            return false;
+        }
+        if (!parseOptions(test)) {
+            cerr << path << ":" << lines.size() << ": bad options " << test.options << endl;
+            return false;
+        }
+        test.line = (int)lines.size() - 1;
+        test.milliseconds = 0;
+        tests.push_back(test);
+    }
+    return true;
+}
+
+static void run(Test& test, const string& romsDir) {
+
+    auto start = chrono::steady_clock::now();
+    unique_ptr<Chip8> chip8(new Chip8(true));
+
+    //Platform first: it decides how large a ROM may be
+    chip8->platform = test.platform;
+    chip8->unLoadROM();
+    if (test.rom.compare(0, 4, "hex:") == 0) {
+        //Program written in the manifest (hex bytes loaded at 0x200)
+        string hex = test.rom.substr(4);
+        if (hex.empty() || hex.size() % 2 != 0 || hex.find_first_not_of("0123456789abcdefABCDEF") != string::npos) {
+            test.error = "Bad hex program";
+            return;
+        }
+        for (size_t i = 0; i < hex.size(); i += 2)
+        {
+            chip8->poke(0x200 + (unsigned int)i / 2, (unsigned char)strtoul(hex.substr(i, 2).c_str(), nullptr, 16));
+        }
+    } else {
+        ROMResult result = chip8->loadROM(romsDir + "/" + test.rom);
+        if (result.status != ROMStatus::OK) {
+            test.error = result.message;
+            return;
+        }
+    }
+
+    //The manifest wins over the ROM database
+    chip8->platform = test.platform;
+    chip8->setQuirks(test.quirks);
+    chip8->ipf = Chip8::platformSpeed(test.platform);
+    chip8->seedRandom(test.seed);
+    for (const Poke& poke : test.pokes)
+    {
+        chip8->poke(poke.address, poke.value);
+    }
+
+    for (unsigned long long frame = 0; frame < test.frames; frame++)
+    {
+        chip8->pressedKey = -1;
+        for (const KeyPress& press : test.keys)
+        {
+            if (frame >= press.first && frame <= press.last) {
+                chip8->pressedKey = press.key;
+            }
+        }
+        while (!chip8->cycle())
+        {
+        }
+        chip8->updateTimers();
+    }
+
+    test.hash = chip8->displayHash();
+    test.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+static const char* status(const Test& test) {
+    if (!test.error.empty()) return "ERROR";
+    if (test.golden == "-") return "NEW";
+    return test.hash == test.golden ? "PASS" : "FAIL";
+}
+
+int main(int argc, char** argv) {
+
+    if (argc < 2) {
+        cerr << "Usage: chip8-conformance <manifest> [--roms DIR] [--threads N] [--update]" << endl;
+        return 1;
+    }
+
+    string manifest = argv[1];
+    string romsDir = "roms";
+    unsigned int threads = thread::hardware_concurrency();
+    bool update = false;
+    for (int i = 2; i < argc; i++)
+    {
+        string option = argv[i];
+        if (option == "--roms" && i + 1 < argc) {
+            romsDir = argv[++i];
+        } else if (option == "--threads" && i + 1 < argc) {
+            threads = (unsigned int)atoi(argv[++i]);
+        } else if (option == "--update") {
+            update = true;
+        } else {
+            cerr << "Bad option: " << option << endl;
+            return 1;
+        }
+    }
+
+    vector<Test> tests;
+    vector<string> lines;
+    if (!loadManifest(manifest, tests, lines)) {
+        return 1;
+    }
+
+    //One ROM at a time per worker
+    auto start = chrono::steady_clock::now();
+    atomic<size_t> next(0);
+    vector<thread> workers;
+    threads = threads == 0 ? 1 : threads;
+    for (unsigned int t = 0; t < threads && t < tests.size(); t++)
+    {
+        workers.emplace_back([&]() {
+            for (size_t i = next++; i < tests.size(); i = next++)
+            {
+                run(tests[i], romsDir);
+            }
+        });
+    }
+    for (thread& worker : workers)
+    {
+        worker.join();
+    }
+    double total = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    //Results
+    int failures = 0;
+    for (const Test& test : tests)
+    {
+        const char* result = status(test);
+        printf("%-6s %-24s %-20s %8.1f ms  %s\n", result, test.name.c_str(), test.profile.c_str(), test.milliseconds,
+            test.error.empty() ? test.hash.c_str() : test.error.c_str());
+        //No golden hash: nothing was checked (only --update may leave it)
+        if (strcmp(result, "FAIL") == 0 || strcmp(result, "ERROR") == 0 || (strcmp(result, "NEW") == 0 && !update)) {
+            failures++;
+        }
+    }
+
+    //Matrix: tests x quirk profiles
+    vector<string> profiles;
+    vector<string> names;
+    map<pair<string, string>, const char*> cells;
+    for (const Test& test : tests)
+    {
+        if (find(profiles.begin(), profiles.end(), test.profile) == profiles.end()) {
+            profiles.push_back(test.profile);
+        }
+        if (find(names.begin(), names.end(), test.name) == names.end()) {
+            names.push_back(test.name);
+        }
+        cells[{ test.name, test.profile }] = status(test);
+    }
+
+    printf("\n%-24s", "");
+    for (const string& profile : profiles)
+    {
+        printf(" %-20s", profile.c_str());
+    }
+    printf("\n");
+    for (const string& name : names)
+    {
+        printf("%-24s", name.c_str());
+        for (const string& profile : profiles)
+        {
+            auto cell = cells.find({ name, profile });
+            printf(" %-20s", cell == cells.end() ? "." : cell->second);
+        }
+        printf("\n");
+    }
+    printf("\n%zu tests, %d failed, %.1f ms on %u threads\n", tests.size(), failures, total, threads);
+
+    //Record this run as the new golden hashes
+    if (update) {
+        for (const Test& test : tests)
+        {
+            if (!test.error.empty()) {
+                continue;
+            }
+            string& line = lines[test.line];
+            size_t at = line.rfind(test.golden);
+            if (at != string::npos) {
+                line.replace(at, test.golden.size(), test.hash);
+            }
+        }
+        ofstream file(manifest, ios::out | ios::trunc);
+        for (const string& line : lines)
+        {
+            file << line << "\n";
+        }
+        printf("Updated %s\n", manifest.c_str());
+        return 0;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
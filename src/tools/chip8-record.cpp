@@ -0,0 +1,369 @@
+/*
+    chip8-record
+
+    Reads .c8rec gameplay recordings written by the emulator (F3, see
+    include/chip8/recordfile.h) and exports them. Frames dropped while
+    recording repeat the previous picture, so video and audio stay in sync.
+
+        chip8-record info <file.c8rec>
+        chip8-record y4m <file.c8rec> <out.y4m> [--scale N]
+        chip8-record wav <file.c8rec> <out.wav>
+
+    Video is 128 x 64 times the scale (lo-res pixels are doubled), 60 fps,
+    Y'CbCr 4:4:4 (BT.601), so any encoder can take it:
+
+        ffmpeg -i game.y4m -i game.wav -c:v libx264 -crf 0 game.mp4
+
+    Build:
+        g++ -std=c++17 -Isrc/include/chip8 src/tools/chip8-record.cpp -o chip8-record
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <recordfile.h>
+
+using namespace std;
+
+
+static const int PLANES = 2;
+static const int ROW_BYTES = 16;            // 128 pixels
+static const int ROWS = 64;
+static const short AMPLITUDE = 3000;        // Same as the emulator's audio
+
+//One decoded frame
+struct Frame {
+    unsigned int frame;
+    bool hires;
+    bool key;
+    unsigned int fileBytes;                 // Size of the record
+    unsigned int palette[1 << PLANES];
+    unsigned char planes[PLANES][ROWS][ROW_BYTES];
+    vector<RecordEvent> events;
+
+    //Colour index of a pixel on the 128 x 64 grid (lo-res pixels cover 2 x 2)
+    int pixel(int x, int y) const {
+        if (!hires) {
+            x >>= 1;
+            y >>= 1;
+        }
+        int index = 0;
+        for (int plane = 0; plane < PLANES; plane++)
+        {
+            index |= ((planes[plane][y][x >> 3] >> (7 - (x & 7))) & 1) << plane;
+        }
+        return index;
+    }
+};
+
+//Calls visit() for every frame in order. Returns false on a bad file.
+template <typename Visit>
+static bool readRecording(const string& path, RecordHeader& header, Visit visit) {
+
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL) {
+        cerr << "Can't open " << path << endl;
+        return false;
+    }
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, RECORD_MAGIC, 4) != 0 ||
+            header.version != RECORD_VERSION || header.frameSamples == 0) {
+        cerr << path << " is not a chip8 recording" << endl;
+        fclose(file);
+        return false;
+    }
+
+    Frame frame;
+    memset(frame.palette, 0, sizeof(frame.palette));
+    memset(frame.planes, 0, sizeof(frame.planes));
+    vector<unsigned char> coded;
+    vector<unsigned char> raw;
+
+    RecordFrame record;
+    bool ok = true;
+    while (ok && fread(&record, sizeof(record), 1, file) == 1)
+    {
+        frame.frame = record.frame;
+        frame.hires = (record.flags & RECORD_HIRES) != 0;
+        frame.key = (record.flags & RECORD_KEY) != 0;
+        frame.fileBytes = sizeof(record) + record.videoBytes + record.events * sizeof(RecordEvent);
+        if (record.flags & RECORD_PALETTE) {
+            ok = fread(frame.palette, sizeof(frame.palette), 1, file) == 1;
+            frame.fileBytes += sizeof(frame.palette);
+        }
+        coded.resize(record.videoBytes);
+        frame.events.resize(record.events);
+        ok = ok && fread(coded.data(), 1, coded.size(), file) == coded.size() &&
+            fread(frame.events.data(), sizeof(RecordEvent), record.events, file) == record.events;
+
+        //Run-length decode, then XOR into the current picture
+        raw.clear();
+        for (size_t i = 0; ok && i < coded.size(); )
+        {
+            unsigned char c = coded[i++];
+            if (c < 128 && i + c + 1 <= coded.size()) {
+                raw.insert(raw.end(), coded.begin() + i, coded.begin() + i + c + 1);
+                i += c + 1;
+            } else if (c >= 128 && i < coded.size()) {
+                raw.insert(raw.end(), c - 126, coded[i++]);
+            } else {
+                ok = false;
+            }
+        }
+        int rows = frame.hires ? ROWS : ROWS / 2;
+        int rowBytes = frame.hires ? ROW_BYTES : ROW_BYTES / 2;
+        ok = ok && raw.size() == (size_t)(PLANES * rows * rowBytes);
+        if (!ok) {
+            break;
+        }
+        if (frame.key) {
+            memset(frame.planes, 0, sizeof(frame.planes));
+        }
+        const unsigned char* in = raw.data();
+        for (int plane = 0; plane < PLANES; plane++)
+        {
+            for (int y = 0; y < rows; y++)
+            {
+                for (int x = 0; x < rowBytes; x++)
+                {
+                    frame.planes[plane][y][x] ^= *in++;
+                }
+            }
+        }
+        visit(frame);
+    }
+    if (!ok) {
+        cerr << path << ": truncated or corrupt frame record" << endl;
+    }
+    fclose(file);
+    return true;
+}
+
+//Number of frames to output for this record: 1, plus the ones dropped before it
+static unsigned int span(const Frame& frame, bool first, unsigned int last) {
+    if (first || frame.frame <= last) {
+        return 1;
+    }
+    return frame.frame - last;
+}
+
+static int info(const string& path) {
+
+    RecordHeader header;
+    unsigned long long frames = 0;
+    unsigned long long played = 0;
+    unsigned long long keys = 0;
+    unsigned long long events = 0;
+    unsigned long long bytes = sizeof(header);
+    unsigned int last = 0;
+    bool ok = readRecording(path, header, [&](const Frame& frame) {
+        played += span(frame, frames == 0, last);
+        last = frame.frame;
+        frames++;
+        keys += frame.key ? 1 : 0;
+        events += frame.events.size();
+        bytes += frame.fileBytes;
+    });
+    if (!ok) {
+        return 1;
+    }
+    printf("Frames:     %llu (%llu dropped)\n", frames, played - frames);
+    printf("Duration:   %.2f s at %u fps\n", (double)played / header.fps, header.fps);
+    printf("Keyframes:  %llu\n", keys);
+    printf("Audio:      %llu state changes, %u Hz\n", events, header.sampleRate);
+    printf("Size:       %llu bytes (%.1f per frame, raw 2 planes 128x64: %d)\n", bytes,
+        frames > 0 ? (double)bytes / frames : 0.0, PLANES * ROWS * ROW_BYTES);
+    return 0;
+}
+
+static int y4m(const string& path, const string& out, int scale) {
+
+    FILE* file = fopen(out.c_str(), "wb");
+    if (file == NULL) {
+        cerr << "Can't create " << out << endl;
+        return 1;
+    }
+
+    int width = ROW_BYTES * 8 * scale;
+    int height = ROWS * scale;
+    fprintf(file, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C444\n", width, height);
+    vector<unsigned char> picture(width * height * 3);
+
+    unsigned long long written = 0;
+    unsigned int last = 0;
+    RecordHeader header;
+    bool ok = readRecording(path, header, [&](const Frame& frame) {
+
+        //Palette to Y'CbCr (BT.601, studio range)
+        unsigned char yuv[1 << PLANES][3];
+        for (int i = 0; i < (1 << PLANES); i++)
+        {
+            double r = (frame.palette[i] >> 16) & 0xFF;
+            double g = (frame.palette[i] >> 8) & 0xFF;
+            double b = frame.palette[i] & 0xFF;
+            yuv[i][0] = (unsigned char)lround(16 + (65.738 * r + 129.057 * g + 25.064 * b) / 256);
+            yuv[i][1] = (unsigned char)lround(128 + (-37.945 * r - 74.494 * g + 112.439 * b) / 256);
+            yuv[i][2] = (unsigned char)lround(128 + (112.439 * r - 94.154 * g - 18.285 * b) / 256);
+        }
+
+        //Dropped frames: the last picture again
+        unsigned int repeat = span(frame, written == 0, last) - 1;
+        for (unsigned int i = 0; i < repeat; i++)
+        {
+            fwrite("FRAME\n", 1, 6, file);
+            fwrite(picture.data(), 1, picture.size(), file);
+        }
+
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                int index = frame.pixel(x / scale, y / scale);
+                for (int c = 0; c < 3; c++)
+                {
+                    picture[(c * height + y) * width + x] = yuv[index][c];
+                }
+            }
+        }
+        fwrite("FRAME\n", 1, 6, file);
+        fwrite(picture.data(), 1, picture.size(), file);
+        written += repeat + 1;
+        last = frame.frame;
+    });
+    fclose(file);
+    if (!ok) {
+        return 1;
+    }
+    printf("%s: %llu frames, %dx%d\n", out.c_str(), written, width, height);
+    return 0;
+}
+
+static void put16(FILE* file, unsigned int value) {
+    fputc(value & 0xFF, file);
+    fputc((value >> 8) & 0xFF, file);
+}
+
+static void put32(FILE* file, unsigned int value) {
+    put16(file, value & 0xFFFF);
+    put16(file, value >> 16);
+}
+
+static int wav(const string& path, const string& out) {
+
+    FILE* file = fopen(out.c_str(), "wb");
+    if (file == NULL) {
+        cerr << "Can't create " << out << endl;
+        return 1;
+    }
+
+    //Header first, sizes filled in at the end
+    fwrite("RIFF\0\0\0\0WAVEfmt ", 1, 16, file);
+    put32(file, 16);
+    put16(file, 1);                         // PCM
+    put16(file, 1);                         // Mono
+    put32(file, 0);                         // Sample rate (below)
+    put32(file, 0);                         // Bytes per second
+    put16(file, 2);
+    put16(file, 16);
+    fwrite("data\0\0\0\0", 1, 8, file);
+
+    //Same synthesis as Audio::mix: the 32-bit phase covers the 128 bit pattern
+    RecordEvent state;
+    memset(&state, 0, sizeof(state));
+    unsigned int phaseStep[256];
+    unsigned int phase = 0;
+    unsigned long long samples = 0;
+    unsigned int last = 0;
+    bool first = true;
+    vector<short> buffer;
+
+    RecordHeader header;
+    bool ok = readRecording(path, header, [&](const Frame& frame) {
+
+        if (first) {
+            for (int p = 0; p < 256; p++)
+            {
+                double bitsPerSecond = 4000.0 * pow(2.0, (p - 64) / 48.0);
+                phaseStep[p] = (unsigned int)(bitsPerSecond / header.sampleRate * 33554432.0);
+            }
+        }
+
+        //Dropped frames keep the last state playing
+        unsigned int frames = span(frame, first, last);
+        buffer.resize(frames * header.frameSamples);
+        unsigned int start = (frames - 1) * header.frameSamples;
+        size_t next = 0;
+        for (unsigned int n = 0; n < buffer.size(); n++)
+        {
+            while (next < frame.events.size() && start + frame.events[next].offset <= n)
+            {
+                state = frame.events[next++];
+            }
+            if (state.playing) {
+                unsigned int bit = phase >> 25;
+                buffer[n] = (state.pattern[bit >> 3] >> (7 - (bit & 7))) & 1 ? AMPLITUDE : -AMPLITUDE;
+                phase += phaseStep[state.pitch];
+            } else {
+                buffer[n] = 0;
+            }
+        }
+        //Changes at the very end of the frame apply from the next one
+        for (; next < frame.events.size(); next++)
+        {
+            state = frame.events[next];
+        }
+        fwrite(buffer.data(), sizeof(short), buffer.size(), file);
+        samples += buffer.size();
+        last = frame.frame;
+        first = false;
+    });
+
+    unsigned int rate = ok ? header.sampleRate : 0;
+    fseek(file, 4, SEEK_SET);
+    put32(file, (unsigned int)(36 + samples * 2));
+    fseek(file, 24, SEEK_SET);
+    put32(file, rate);
+    put32(file, rate * 2);
+    fseek(file, 40, SEEK_SET);
+    put32(file, (unsigned int)(samples * 2));
+    fclose(file);
+    if (!ok) {
+        return 1;
+    }
+    printf("%s: %llu samples, %.2f s\n", out.c_str(), samples, rate > 0 ? (double)samples / rate : 0.0);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+
+    string command = argc > 1 ? argv[1] : "";
+    if (argc < 3 || (command != "info" && command != "y4m" && command != "wav") || (command != "info" && argc < 4)) {
+        cerr << "Usage: chip8-record info <file.c8rec>" << endl;
+        cerr << "       chip8-record y4m <file.c8rec> <out.y4m> [--scale N]" << endl;
+        cerr << "       chip8-record wav <file.c8rec> <out.wav>" << endl;
+        return 1;
+    }
+
+    int scale = 4;
+    for (int i = command == "info" ? 3 : 4; i < argc; i++)
+    {
+        string option = argv[i];
+        if (option == "--scale" && i + 1 < argc && atoi(argv[i + 1]) >= 1 && atoi(argv[i + 1]) <= 16) {
+            scale = atoi(argv[i + 1]);
+            i++;
+        } else {
+            cerr << "Bad option: " << option << endl;
+            return 1;
+        }
+    }
+
+    if (command == "info") {
+        return info(argv[2]);
+    }
+    if (command == "y4m") {
+        return y4m(argv[2], argv[3], scale);
+    }
+    return wav(argv[2], argv[3]);
+}
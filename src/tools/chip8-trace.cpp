@@ -0,0 +1,234 @@
+/*
+    chip8-trace
+
+    Reads .c8trace files written by the emulator's trace points (see
+    include/chip8/tracefile.h). Files are streamed in blocks, so traces of
+    any size can be filtered and summarized without loading them.
+
+        chip8-trace summary <file.c8trace> [filters]
+        chip8-trace dump <file.c8trace> [filters] [--limit N]
+
+    Filters:
+        --pc 200-2FF        PC range (hex)
+        --op F0FF:F033      opcode & mask == value (hex)
+        --frames 10-20      frame range
+        --branch            only records whose next PC is not PC + 2
+
+    Build:
+        g++ -std=c++17 -Isrc/include/chip8 src/tools/chip8-trace.cpp src/chip8/profiler.cpp -o chip8-trace
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <tracefile.h>
+#include <profiler.h>
+
+using namespace std;
+
+
+struct Filter {
+    unsigned short pcStart = 0x0000;
+    unsigned short pcEnd = 0xFFFF;
+    unsigned short mask = 0x0000;
+    unsigned short match = 0x0000;
+    unsigned long long frameStart = 0;
+    unsigned long long frameEnd = ~0ULL;
+    bool branchOnly = false;
+
+    bool accepts(const TraceRecord& record) const {
+        return record.pc >= pcStart && record.pc <= pcEnd &&
+            (record.opcode & mask) == match &&
+            record.frame >= frameStart && record.frame <= frameEnd &&
+            (!branchOnly || (record.flags & TRACE_BRANCH));
+    }
+};
+
+static bool parseRange(const char* text, unsigned long long& start, unsigned long long& end, int base) {
+    char* rest;
+    start = strtoull(text, &rest, base);
+    if (*rest == 0) {
+        end = start;
+        return true;
+    }
+    if (*rest != '-') {
+        return false;
+    }
+    end = strtoull(rest + 1, &rest, base);
+    return *rest == 0 && start <= end;
+}
+
+//Calls visit() for every record that passes the filter. Returns false on a bad file.
+template <typename Visit>
+static bool readTrace(const string& path, const Filter& filter, Visit visit) {
+
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL) {
+        cerr << "Can't open " << path << endl;
+        return false;
+    }
+
+    TraceHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, TRACE_MAGIC, 4) != 0 ||
+            header.recordSize < sizeof(TraceRecord)) {
+        cerr << path << " is not a chip8 trace file" << endl;
+        fclose(file);
+        return false;
+    }
+
+    //Newer versions may append fields: step by recordSize, read the known prefix.
+    //Records past the count in the header are space the writer never filled.
+    const size_t BLOCK = 65536;
+    vector<unsigned char> buffer(BLOCK * header.recordSize);
+    unsigned long long left = header.records;
+    size_t read;
+    bool more = true;
+    while (more && left > 0 && (read = fread(buffer.data(), header.recordSize, (size_t)min((unsigned long long)BLOCK, left), file)) > 0)
+    {
+        left -= read;
+        for (size_t i = 0; i < read && more; i++)
+        {
+            TraceRecord record;
+            memcpy(&record, buffer.data() + i * header.recordSize, sizeof(record));
+            if (filter.accepts(record)) {
+                more = visit(record);
+            }
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static int summary(const string& path, const Filter& filter) {
+
+    unsigned long long records = 0;
+    unsigned long long branches = 0;
+    unsigned long long firstFrame = ~0ULL;
+    unsigned long long lastFrame = 0;
+    vector<unsigned long long> classCount(Profiler::OP_CLASSES, 0);
+    vector<unsigned long long> classTaken(Profiler::OP_CLASSES, 0);
+    vector<unsigned int> pcCount(0x10000, 0);
+
+    bool ok = readTrace(path, filter, [&](const TraceRecord& record) {
+        int opClass = Profiler::opcodeClass(record.opcode);
+        records++;
+        classCount[opClass]++;
+        pcCount[record.pc]++;
+        if (record.flags & TRACE_BRANCH) {
+            branches++;
+            classTaken[opClass]++;
+        }
+        firstFrame = min(firstFrame, (unsigned long long)record.frame);
+        lastFrame = max(lastFrame, (unsigned long long)record.frame);
+        return true;
+    });
+    if (!ok) {
+        return 1;
+    }
+    if (records == 0) {
+        cout << "No matching records" << endl;
+        return 0;
+    }
+
+    printf("Records:  %llu\n", records);
+    printf("Frames:   %llu-%llu\n", firstFrame, lastFrame);
+    printf("Branches: %llu (%.1f%%)\n\n", branches, 100.0 * branches / records);
+
+    //Instruction mix, most frequent first
+    vector<int> order;
+    for (int c = 0; c < Profiler::OP_CLASSES; c++)
+    {
+        if (classCount[c] > 0) {
+            order.push_back(c);
+        }
+    }
+    sort(order.begin(), order.end(), [&](int a, int b) { return classCount[a] > classCount[b]; });
+
+    printf("%-14s %12s %7s %8s\n", "Class", "Count", "Mix", "Taken");
+    for (int c : order)
+    {
+        printf("%-14s %12llu %6.1f%% %7.1f%%\n", Profiler::className(c), classCount[c],
+            100.0 * classCount[c] / records, 100.0 * classTaken[c] / classCount[c]);
+    }
+
+    //Hottest PCs
+    vector<unsigned int> hot;
+    for (unsigned int pc = 0; pc < 0x10000; pc++)
+    {
+        if (pcCount[pc] > 0) {
+            hot.push_back(pc);
+        }
+    }
+    size_t top = min((size_t)10, hot.size());
+    partial_sort(hot.begin(), hot.begin() + top, hot.end(), [&](unsigned int a, unsigned int b) { return pcCount[a] > pcCount[b]; });
+    printf("\nHottest PCs\n");
+    for (size_t i = 0; i < top; i++)
+    {
+        printf("  %03X %12u %6.1f%%\n", hot[i], pcCount[hot[i]], 100.0 * pcCount[hot[i]] / records);
+    }
+    return 0;
+}
+
+static int dump(const string& path, const Filter& filter, unsigned long long limit) {
+
+    unsigned long long printed = 0;
+    printf("%8s %5s %4s %4s %4s %4s %2s %2s %2s %2s %2s\n", "frame", "step", "pc", "op", "next", "I", "vx", "vy", "=>", "vf", "sp");
+    bool ok = readTrace(path, filter, [&](const TraceRecord& record) {
+        if (printed == limit) {
+            return false;
+        }
+        printf("%8u %5u %04X %04X %04X %04X %02X %02X %02X %02X %02X %-11s%s\n", record.frame, record.step, record.pc,
+            record.opcode, record.nextPC, record.index, record.vx, record.vy, record.result, record.vf, record.sp,
+            Profiler::className(Profiler::opcodeClass(record.opcode)), (record.flags & TRACE_BRANCH) ? " *" : "");
+        return ++printed < limit;
+    });
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+
+    if (argc < 3 || (strcmp(argv[1], "summary") != 0 && strcmp(argv[1], "dump") != 0)) {
+        cerr << "Usage: chip8-trace summary|dump <file.c8trace> [--pc A-B] [--op MASK:VALUE] [--frames A-B] [--branch] [--limit N]" << endl;
+        return 1;
+    }
+
+    Filter filter;
+    unsigned long long limit = ~0ULL;
+    for (int i = 3; i < argc; i++)
+    {
+        string option = argv[i];
+        bool hasValue = i + 1 < argc;
+        unsigned long long start;
+        unsigned long long end;
+
+        if (option == "--branch") {
+            filter.branchOnly = true;
+        } else if (option == "--pc" && hasValue && parseRange(argv[i + 1], start, end, 16) && end <= 0xFFFF) {
+            filter.pcStart = (unsigned short)start;
+            filter.pcEnd = (unsigned short)end;
+            i++;
+        } else if (option == "--frames" && hasValue && parseRange(argv[i + 1], start, end, 10)) {
+            filter.frameStart = start;
+            filter.frameEnd = end;
+            i++;
+        } else if (option == "--op" && hasValue && strchr(argv[i + 1], ':') != NULL) {
+            filter.mask = (unsigned short)strtoul(argv[i + 1], nullptr, 16);
+            filter.match = (unsigned short)strtoul(strchr(argv[i + 1], ':') + 1, nullptr, 16) & filter.mask;
+            i++;
+        } else if (option == "--limit" && hasValue) {
+            limit = strtoull(argv[i + 1], nullptr, 10);
+            i++;
+        } else {
+            cerr << "Bad option: " << option << endl;
+            return 1;
+        }
+    }
+
+    if (strcmp(argv[1], "summary") == 0) {
+        return summary(argv[2], filter);
+    }
+    return dump(argv[2], filter, limit);
+}
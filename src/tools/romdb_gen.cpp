@@ -0,0 +1,485 @@
+/*
+    romdb_gen
+
+    Generates include/chip8/romdb_table.h from the community chip-8-database
+    (https://github.com/chip-8/chip-8-database). Run it whenever the database
+    is updated:
+
+        romdb_gen path/to/chip-8-database/database path/to/src/include/chip8/romdb_table.h
+
+    build.sh runs it before every build. It reads platforms.json (default quirks and tickrate of every platform) and
+    programs.json (per ROM platforms, quirk overrides and tickrate) and writes
+    an open-addressed hash table keyed by SHA-1.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <quirks.h>
+
+using namespace std;
+
+
+//----Minimal JSON reader----
+
+struct Json {
+    enum Type { Null, Bool, Number, String, Array, Object } type = Null;
+    bool boolean = false;
+    double number = 0;
+    string text;
+    vector<Json> items;
+    vector<pair<string, Json>> members;
+
+    const Json* get(const string& key) const {
+        for (const auto& member : members)
+        {
+            if (member.first == key) {
+                return &member.second;
+            }
+        }
+        return nullptr;
+    }
+};
+
+class JsonParser {
+
+    public:
+        JsonParser(const string& source) : src(source), pos(0) {}
+
+        bool parse(Json& out) {
+            skipSpace();
+            if (!value(out)) {
+                return false;
+            }
+            skipSpace();
+            return pos == src.size();
+        }
+
+    private:
+        const string& src;
+        size_t pos;
+
+        void skipSpace() {
+            while (pos < src.size() && (src[pos] == ' ' || src[pos] == '\t' || src[pos] == '\n' || src[pos] == '\r'))
+            {
+                pos++;
+            }
+        }
+
+        bool literal(const char* word) {
+            size_t length = strlen(word);
+            if (src.compare(pos, length, word) != 0) {
+                return false;
+            }
+            pos += length;
+            return true;
+        }
+
+        bool value(Json& out) {
+            if (pos >= src.size()) {
+                return false;
+            }
+            char c = src[pos];
+            if (c == '{') return object(out);
+            if (c == '[') return array(out);
+            if (c == '"') {
+                out.type = Json::String;
+                return str(out.text);
+            }
+            if (literal("true")) {
+                out.type = Json::Bool;
+                out.boolean = true;
+                return true;
+            }
+            if (literal("false")) {
+                out.type = Json::Bool;
+                return true;
+            }
+            if (literal("null")) {
+                return true;
+            }
+            char* end;
+            out.number = strtod(src.c_str() + pos, &end);
+            if (end == src.c_str() + pos) {
+                return false;
+            }
+            out.type = Json::Number;
+            pos = end - src.c_str();
+            return true;
+        }
+
+        bool str(string& out) {
+            pos++;
+            while (pos < src.size() && src[pos] != '"')
+            {
+                char c = src[pos++];
+                if (c != '\\') {
+                    out += c;
+                    continue;
+                }
+                if (pos >= src.size()) {
+                    return false;
+                }
+                char e = src[pos++];
+                switch (e)
+                {
+                    case 'n': out += '\n'; break;
+                    case 't': out += '\t'; break;
+                    case 'r': out += '\r'; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'u': {
+                        //Encode the code point as UTF-8 (surrogates are kept as-is)
+                        unsigned int cp = (unsigned int)strtoul(src.substr(pos, 4).c_str(), nullptr, 16);
+                        pos += 4;
+                        if (cp < 0x80) {
+                            out += (char)cp;
+                        } else if (cp < 0x800) {
+                            out += (char)(0xC0 | (cp >> 6));
+                            out += (char)(0x80 | (cp & 0x3F));
+                        } else {
+                            out += (char)(0xE0 | (cp >> 12));
+                            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+                            out += (char)(0x80 | (cp & 0x3F));
+                        }
+                        break;
+                    }
+                    default: out += e; break;
+                }
+            }
+            if (pos >= src.size()) {
+                return false;
+            }
+            pos++;
+            return true;
+        }
+
+        bool array(Json& out) {
+            out.type = Json::Array;
+            pos++;
+            skipSpace();
+            if (pos < src.size() && src[pos] == ']') {
+                pos++;
+                return true;
+            }
+            while (pos < src.size())
+            {
+                Json item;
+                skipSpace();
+                if (!value(item)) {
+                    return false;
+                }
+                out.items.push_back(std::move(item));
+                skipSpace();
+                if (pos < src.size() && src[pos] == ',') {
+                    pos++;
+                    continue;
+                }
+                if (pos < src.size() && src[pos] == ']') {
+                    pos++;
+                    return true;
+                }
+                return false;
+            }
+            return false;
+        }
+
+        bool object(Json& out) {
+            out.type = Json::Object;
+            pos++;
+            skipSpace();
+            if (pos < src.size() && src[pos] == '}') {
+                pos++;
+                return true;
+            }
+            while (pos < src.size())
+            {
+                string key;
+                skipSpace();
+                if (pos >= src.size() || src[pos] != '"' || !str(key)) {
+                    return false;
+                }
+                skipSpace();
+                if (pos >= src.size() || src[pos] != ':') {
+                    return false;
+                }
+                pos++;
+                skipSpace();
+                Json item;
+                if (!value(item)) {
+                    return false;
+                }
+                out.members.emplace_back(key, std::move(item));
+                skipSpace();
+                if (pos < src.size() && src[pos] == ',') {
+                    pos++;
+                    continue;
+                }
+                if (pos < src.size() && src[pos] == '}') {
+                    pos++;
+                    return true;
+                }
+                return false;
+            }
+            return false;
+        }
+};
+
+static bool loadJson(const string& fileName, Json& out) {
+    ifstream in(fileName, ios::in | ios::binary);
+    if (!in.is_open()) {
+        cerr << "Could not open " << fileName << endl;
+        return false;
+    }
+    stringstream buffer;
+    buffer << in.rdbuf();
+    string text = buffer.str();
+    if (!JsonParser(text).parse(out)) {
+        cerr << "Could not parse " << fileName << endl;
+        return false;
+    }
+    return true;
+}
+
+
+//----Database----
+
+struct PlatformInfo {
+    int platform;
+    unsigned char quirks;
+    int tickrate;
+};
+
+struct Record {
+    unsigned char sha1[20];
+    int platform;
+    unsigned char quirks;
+    int ipf;
+    string title;
+};
+
+static int mapPlatform(const string& id) {
+    if (id == "originalChip8" || id == "hybridVIP" || id == "modernChip8") return (int)Platform::CHIP8;
+    if (id == "chip48" || id == "superchip1" || id == "superchip") return (int)Platform::SCHIP;
+    if (id == "xochip") return (int)Platform::XOCHIP;
+    return -1;
+}
+
+static unsigned char applyQuirks(unsigned char quirks, const Json* json) {
+    static const pair<const char*, unsigned char> names[] = {
+        { "shift", QUIRK_SHIFT },
+        { "memoryIncrementByX", QUIRK_MEMORY_INCREMENT },
+        { "memoryLeaveIUnchanged", QUIRK_MEMORY_LEAVE_I },
+        { "wrap", QUIRK_WRAP },
+        { "jump", QUIRK_JUMP },
+        { "vblank", QUIRK_VBLANK },
+        { "logic", QUIRK_LOGIC }
+    };
+    if (json == nullptr) {
+        return quirks;
+    }
+    for (const auto& name : names)
+    {
+        const Json* flag = json->get(name.first);
+        if (flag != nullptr && flag->type == Json::Bool) {
+            quirks = flag->boolean ? (quirks | name.second) : (quirks & ~name.second);
+        }
+    }
+    return quirks;
+}
+
+static bool parseSha1(const string& hex, unsigned char out[20]) {
+    if (hex.size() != 40) {
+        return false;
+    }
+    for (int i = 0; i < 20; i++)
+    {
+        char byte[3] = { hex[i * 2], hex[i * 2 + 1], 0 };
+        char* end;
+        out[i] = (unsigned char)strtoul(byte, &end, 16);
+        if (*end != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static string escape(const string& text) {
+    string out;
+    for (unsigned char c : text)
+    {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += (char)c;
+        } else if (c < 0x20 || c >= 0x7F) {
+            char octal[8];
+            snprintf(octal, sizeof(octal), "\\%03o", c);
+            out += octal;
+        } else {
+            out += (char)c;
+        }
+    }
+    return out;
+}
+
+//Same probe as romdbLookup() (romdb.cpp): index of the record, or -1
+static int probe(const vector<Record>& records, const vector<int>& table, const unsigned char sha1[20]) {
+    unsigned int mask = (unsigned int)table.size() - 1;
+    unsigned int slot = ((unsigned int)sha1[0] << 24 | (unsigned int)sha1[1] << 16 | (unsigned int)sha1[2] << 8 | (unsigned int)sha1[3]) & mask;
+    while (table[slot] >= 0)
+    {
+        if (memcmp(records[table[slot]].sha1, sha1, 20) == 0) {
+            return table[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+int main(int argc, char** argv) {
+
+    if (argc != 3) {
+        cerr << "Usage: romdb_gen <chip-8-database/database> <romdb_table.h>" << endl;
+        return 1;
+    }
+    string dir = argv[1];
+
+    Json platformsJson;
+    Json programsJson;
+    if (!loadJson(dir + "/platforms.json", platformsJson) || !loadJson(dir + "/programs.json", programsJson)) {
+        return 1;
+    }
+
+    //Platform defaults
+    map<string, PlatformInfo> platforms;
+    for (const Json& entry : platformsJson.items)
+    {
+        const Json* id = entry.get("id");
+        if (id == nullptr || mapPlatform(id->text) < 0) {
+            continue;
+        }
+        PlatformInfo info;
+        info.platform = mapPlatform(id->text);
+        info.quirks = applyQuirks(0, entry.get("quirks"));
+        const Json* tickrate = entry.get("defaultTickrate");
+        info.tickrate = tickrate != nullptr ? (int)tickrate->number : 0;
+        platforms[id->text] = info;
+    }
+
+    //ROMs (first supported platform wins)
+    vector<Record> records;
+    for (const Json& program : programsJson.items)
+    {
+        const Json* title = program.get("title");
+        const Json* roms = program.get("roms");
+        if (roms == nullptr) {
+            continue;
+        }
+        for (const auto& rom : roms->members)
+        {
+            Record record;
+            if (!parseSha1(rom.first, record.sha1)) {
+                continue;
+            }
+
+            const Json* romPlatforms = rom.second.get("platforms");
+            const PlatformInfo* info = nullptr;
+            string platformId;
+            for (size_t i = 0; romPlatforms != nullptr && i < romPlatforms->items.size() && info == nullptr; i++)
+            {
+                auto found = platforms.find(romPlatforms->items[i].text);
+                if (found != platforms.end()) {
+                    info = &found->second;
+                    platformId = found->first;
+                }
+            }
+            if (info == nullptr) {
+                continue;
+            }
+
+            record.platform = info->platform;
+            record.quirks = info->quirks;
+            const Json* quirky = rom.second.get("quirkyPlatforms");
+            if (quirky != nullptr) {
+                record.quirks = applyQuirks(record.quirks, quirky->get(platformId));
+            }
+            const Json* tickrate = rom.second.get("tickrate");
+            record.ipf = tickrate != nullptr ? (int)tickrate->number : info->tickrate;
+            record.title = title != nullptr ? title->text : rom.first;
+            records.push_back(record);
+        }
+    }
+
+    if (records.empty()) {
+        cerr << "No ROMs of a supported platform in " << dir << endl;
+        return 1;
+    }
+
+    //Open addressing, at most half full
+    unsigned int slots = 1;
+    while (slots < records.size() * 2)
+    {
+        slots <<= 1;
+    }
+    vector<int> table(slots, -1);
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const unsigned char* h = records[i].sha1;
+        unsigned int slot = ((unsigned int)h[0] << 24 | (unsigned int)h[1] << 16 | (unsigned int)h[2] << 8 | (unsigned int)h[3]) & (slots - 1);
+        while (table[slot] >= 0)
+        {
+            slot = (slot + 1) & (slots - 1);
+        }
+        table[slot] = (int)i;
+    }
+    //Check: every ROM resolves to its record through the probe romdbLookup() uses
+    //(a hash listed twice resolves to its first record)
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        int found = probe(records, table, records[i].sha1);
+        if (found < 0 || (size_t)found > i || memcmp(records[found].sha1, records[i].sha1, 20) != 0) {
+            cerr << "Lookup check failed for " << records[i].title << endl;
+            return 1;
+        }
+    }
+
+    //Write Header
+    ofstream out(argv[2], ios::out | ios::trunc);
+    if (!out.is_open()) {
+        cerr << "Could not write " << argv[2] << endl;
+        return 1;
+    }
+    out << "// romdb_table.h\n";
+    out << "// Generated by tools/romdb_gen.cpp from the chip-8-database. Do not edit.\n";
+    out << "#ifndef romdb_table_h\n#define romdb_table_h\n\n";
+    out << "static const unsigned int ROMDB_COUNT = " << records.size() << ";\n";
+    out << "static const unsigned int ROMDB_SLOTS = " << slots << ";\n\n";
+    out << "static const RomDBRecord romdbRecords[] = {\n";
+    for (const Record& record : records)
+    {
+        out << "    { {";
+        for (int i = 0; i < 20; i++)
+        {
+            char byte[8];
+            snprintf(byte, sizeof(byte), "%s0x%02X", i ? "," : "", record.sha1[i]);
+            out << byte;
+        }
+        out << "}, " << record.platform << ", " << (int)record.quirks << ", " << record.ipf << ", \"" << escape(record.title) << "\" },\n";
+    }
+    out << "};\n\n";
+    out << "static const int romdbSlotTable[ROMDB_SLOTS] = {";
+    for (unsigned int i = 0; i < slots; i++)
+    {
+        out << (i % 16 == 0 ? "\n    " : " ") << table[i] << ",";
+    }
+    out << "\n};\n\n#endif\n";
+
+    cout << "Wrote " << records.size() << " ROMs (" << slots << " slots, every lookup checked) to " << argv[2] << endl;
+    return 0;
+}